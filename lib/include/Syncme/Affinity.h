@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <Syncme/Api.h>
+
+namespace Syncme
+{
+  // List of logical CPU numbers. Empty set means "no restriction"
+  typedef std::vector<uint32_t> CpuSet;
+
+  SINCMELNK uint32_t GetCpuCount();
+  SINCMELNK uint32_t GetCurrentCpu();
+
+  // NUMA topology. Nodes are numbered by ids of the system, nodes
+  // without CPUs (memory-only or not online) have empty sets. Systems
+  // without NUMA information are reported as one node with all CPUs
+  SINCMELNK uint32_t GetNumaNodeCount();
+  SINCMELNK CpuSet GetNumaNodeCpus(uint32_t node);
+  SINCMELNK uint32_t GetNumaNodeOfCpu(uint32_t cpu);
+  SINCMELNK uint32_t GetCurrentNumaNode();
+
+  SINCMELNK CpuSet GetCurrentThreadAffinity();
+  SINCMELNK bool SetCurrentThreadAffinity(const CpuSet& cpus);
+
+  // CPUs for internal threads of the library (TimerQueue, SocketEventQueue,
+  // WaitThread, Task::Queue and pool workers without own affinity).
+  // Applied to threads which are started after the call
+  SINCMELNK void SetRuntimeAffinity(const CpuSet& cpus);
+  SINCMELNK CpuSet GetRuntimeAffinity();
+
+  // Called by internal threads at startup
+  SINCMELNK void ApplyRuntimeAffinity();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include <Syncme/Api.h>
+#include <Syncme/Sync.h>
+
+namespace Syncme
+{
+  // Blocks while word is equal to expected. Returns false if ms elapsed.
+  // Like the system futex the function can return spuriously, so 
+  // callers have to check the word again
+  SINCMELNK bool FutexWait(std::atomic<uint32_t>& word, uint32_t expected, uint32_t ms = FOREVER);
+
+  SINCMELNK void FutexWakeOne(std::atomic<uint32_t>& word);
+  SINCMELNK void FutexWakeAll(std::atomic<uint32_t>& word);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <Syncme/Api.h>
+
+namespace Syncme
+{
+  struct HistogramSnapshot
+  {
+    uint64_t Count;
+    uint64_t Sum;
+    uint64_t Min;
+    uint64_t Max;
+    std::vector<uint64_t> Buckets;
+
+    // p is in range [0, 100]. Returns the highest value which is 
+    // equivalent (in the histogram precision) to the percentile
+    SINCMELNK uint64_t Percentile(double p) const;
+    SINCMELNK double Mean() const;
+  };
+
+  // Lock-free log-linear histogram of uint64_t values (HDR style). Each 
+  // power of two range is split into 32 linear buckets, so the relative 
+  // error is below 3%. Record() can be called concurrently from any 
+  // number of threads
+  class Histogram
+  {
+  public:
+    constexpr static unsigned SUB_BITS = 5;
+    constexpr static size_t SUB_COUNT = size_t(1) << SUB_BITS;
+    constexpr static size_t BUCKETS = SUB_COUNT * (64 - SUB_BITS + 1);
+
+  private:
+    std::atomic<uint64_t> Buckets[BUCKETS];
+    std::atomic<uint64_t> Sum;
+    std::atomic<uint64_t> Min;
+    std::atomic<uint64_t> Max;
+
+  public:
+    SINCMELNK Histogram();
+
+    SINCMELNK void Record(uint64_t value);
+
+    // Snapshot is not atomic as a whole. Values recorded concurrently 
+    // can be partially included
+    SINCMELNK HistogramSnapshot Snapshot() const;
+    SINCMELNK HistogramSnapshot SnapshotAndReset();
+    SINCMELNK void Reset();
+
+    SINCMELNK static size_t GetBucket(uint64_t value);
+    SINCMELNK static uint64_t GetBucketLimit(size_t bucket);
+
+  private:
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+  };
+}
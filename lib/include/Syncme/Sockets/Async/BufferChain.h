@@ -52,10 +52,19 @@ namespace Syncme
         );
 
         SINCMELNK bool Add(IO::BufferPtr buffer);
+
+        // Copies data to buffers of the buffer pool
+        SINCMELNK bool Append(const void* data, size_t size);
+
+        // Buffers which are not referenced by anybody else are returned
+        // to the buffer pool
         SINCMELNK void Clear();
         SINCMELNK bool IsEmpty() const;
         SINCMELNK size_t Size() const;
         SINCMELNK const std::vector<BufferView>& GetViews() const;
+
+        // Fills spans (e.g. to build an iovec). Returns the number of spans
+        SINCMELNK size_t GetSpans(IO::Span* spans, size_t count) const;
       };
     }
   }
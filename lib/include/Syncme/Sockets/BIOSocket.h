@@ -21,12 +21,15 @@ namespace Syncme
 
     SINCMELNK virtual SKT_ERROR Ossl2SktError(int ret) override;
     SINCMELNK int GetFD() const override;
+    SINCMELNK size_t GetObjectSize() const override;
     SINCMELNK void LogIoError(const char* fn, const char* text) override;
 
     SINCMELNK bool Attach(int socket, bool enableClose = true) override;
 
   private:
     int InternalWrite(const void* buffer, size_t size, int timeout) override;
+    int InternalWriteV(const Sockets::IO::Span* spans, size_t count) override;
+    int InternalSendFile(PendingFile& file) override;
     int InternalRead(void* buffer, size_t size, int timeout) override;
   };
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Syncme/Api.h>
+#include <Syncme/Sockets/Queue.h>
+
+namespace Syncme
+{
+  namespace Sockets
+  {
+    namespace IO
+    {
+      // Default limit of memory held by the pool
+      constexpr static size_t POOL_LIMIT = 16ULL * 1024 * 1024;
+
+      // Number of buffers of one size class cached by a thread
+      constexpr static size_t MAGAZINE_SIZE = 8;
+
+      struct BufferPoolStats
+      {
+        uint64_t Requests;  // AllocateBuffer() calls
+        uint64_t Hits;      // requests which got a cached buffer
+        size_t Held;        // capacity of cached buffers
+        size_t Limit;       // maximal value of Held
+      };
+
+      // Process wide cache of buffers with 4K, 16K, 64K and BUFFER_SIZE
+      // capacity. Each thread keeps a magazine of buffers per size class
+      // and exchanges half of it with a shared depot when it becomes
+      // empty or full. Buffers which do not fit in the limit are freed
+
+      // Returns a buffer with capacity of at least size bytes. A reused
+      // buffer keeps its size and data, so resize() does not zero memory
+      // again. Sizes above BUFFER_SIZE are allocated without the pool
+      SINCMELNK BufferPtr AllocateBuffer(size_t size = BUFFER_SIZE);
+
+      // Buffer must not be referenced by anybody else
+      SINCMELNK void FreeBuffer(BufferPtr b);
+
+      SINCMELNK void SetBufferPoolLimit(size_t limit);
+      SINCMELNK BufferPoolStats GetBufferPoolStats();
+
+      // Releases buffers of the depot. Magazines of threads are released
+      // when the threads exit
+      SINCMELNK void TrimBufferPool();
+    }
+  }
+}
@@ -12,10 +12,16 @@ namespace Syncme
 {
   namespace Sockets
   {
+    namespace Async
+    {
+      class BufferChain;
+    }
+
     namespace IO
     {
       constexpr static size_t LIMIT = 128ULL * 1024;
       constexpr static size_t BUFFER_SIZE = 128ULL * 1024;
+      constexpr static size_t MIN_READ_SIZE = 16ULL * 1024;
       constexpr static size_t KEEP_BUFFERS = 8;
 
       typedef std::vector<char> Buffer;
@@ -23,6 +29,21 @@ namespace Syncme
       typedef std::list<BufferPtr> BufferList;
       typedef std::function<void()> TSignalTxReady;
 
+      // Unsent part of a queued buffer
+      struct Span
+      {
+        const char* Data;
+        size_t Size;
+      };
+
+      // Receive buffers are taken from the buffer pool instead of being
+      // kept per connection, so an idle connection does not keep them
+      SINCMELNK BufferPtr GetScratchBuffer();
+      SINCMELNK void ReleaseScratchBuffer(BufferPtr b);
+
+      // Memory held by the buffer pool
+      SINCMELNK size_t GetScratchMemory();
+
       class Queue
       {
         size_t Limit;
@@ -33,10 +54,18 @@ namespace Syncme
         BufferList Free;
         size_t Total;
 
+        // Bytes of the first packet which were removed by Consume()
+        size_t Offset;
+
+        // Bytes which are queued outside of the buffers (file transfers).
+        // They are counted by IsEmpty() and Size()
+        size_t External;
+
         bool AutoJoin;
 
       public:
         SINCMELNK Queue(size_t limit = LIMIT, TSignalTxReady signal = TSignalTxReady());
+        SINCMELNK ~Queue();
         SINCMELNK void SetSignallReady(TSignalTxReady signal);
         SINCMELNK void SetLimit(size_t limit);
         SINCMELNK bool GetAvailableLimit(size_t& available);
@@ -53,11 +82,37 @@ namespace Syncme
         SINCMELNK BufferPtr PopFirst();
         SINCMELNK void PushFront(BufferPtr b, bool signal = true);
 
+        // Fills spans with queued data starting from the first unsent
+        // byte. Returns the number of spans
+        SINCMELNK size_t GetSpans(Span* spans, size_t count) const;
+
+        // Removes n bytes from the head of the queue. Buffers are given
+        // back to the buffer pool when they are consumed completely, an
+        // idle queue does not keep them
+        SINCMELNK void Consume(size_t n);
+
+        // Moves up to upto bytes to the chain without copying. Buffers
+        // are referenced by the chain and are not reused by the queue.
+        // Returns the number of bytes
+        SINCMELNK size_t MoveTo(Async::BufferChain& chain, size_t upto = -1);
+
+        SINCMELNK void AddExternal(size_t n);
+        SINCMELNK void RemoveExternal(size_t n);
+
+        // Size of data in the buffers only
+        SINCMELNK size_t BufferedSize() const;
+
         SINCMELNK BufferPtr GetBuffer(Queue* borrowFrom = nullptr);
         SINCMELNK BufferPtr PopFree();
         SINCMELNK void PushFree(BufferPtr b);
 
         SINCMELNK void SetAutoJoin(bool f);
+
+        // Capacity of queued and free buffers
+        SINCMELNK void GetMemoryUsage(size_t& queued, size_t& cached) const;
+
+      private:
+        void Locked_DropOffset();
       };
     }
   }
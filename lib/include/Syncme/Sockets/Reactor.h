@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Syncme/Api.h>
+#include <Syncme/Sync.h>
+
+namespace Syncme
+{
+  namespace Implementation
+  {
+    // Set in ReactorWaiter::Ready by events which are not related to the
+    // socket (exit, close, break, tx)
+    constexpr static uint32_t REACTOR_WAKE = 0x100;
+
+    // Readiness of a socket which is registered in the shared reactor.
+    // EVENT_* bits and REACTOR_WAKE are accumulated till the owner takes
+    // them. Owner parks on the word itself, so a waiter does not need
+    // any descriptor
+    struct ReactorWaiter
+    {
+      std::atomic<uint32_t> Ready;
+      uint64_t Id;
+      size_t Shard;
+
+    public:
+      SINCMELNK ReactorWaiter();
+
+      SINCMELNK void Signal(uint32_t bits);
+
+      // Returns accumulated bits or 0 if ms elapsed
+      SINCMELNK uint32_t Take(uint32_t ms);
+    };
+
+    // Edge triggered epoll instances with one dispatcher thread each.
+    // Sockets are spread between them, so the number of descriptors
+    // depends on the number of threads only. Events are EPOLL* flags
+    namespace Reactor
+    {
+      SINCMELNK bool Add(int fd, ReactorWaiter* waiter, uint32_t events);
+      SINCMELNK bool Update(int fd, ReactorWaiter* waiter, uint32_t events);
+
+      // Waiter is not accessed by the reactor after the call
+      SINCMELNK void Remove(int fd, ReactorWaiter* waiter);
+
+      // Number of descriptors used by the reactor threads
+      SINCMELNK size_t GetDescriptors();
+
+      SINCMELNK void Uninitialize();
+    };
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+
+#include <Syncme/Api.h>
+#include <Syncme/Sockets/Queue.h>
+
+namespace Syncme
+{
+  namespace Sockets
+  {
+    namespace IO
+    {
+      // Byte queue for one producer and one consumer thread. Data is kept
+      // in a ring which is allocated once, the positions are atomic, so
+      // no lock and no allocation is needed per chunk. Capacity is
+      // rounded up to a power of two
+      //
+      // Producer: Reserve(), Commit(), Append()
+      // Consumer: GetSpans(), Consume(), Read()
+      // Any thread: Size(), IsEmpty(), GetAvailableLimit()
+      class RingQueue
+      {
+        std::unique_ptr<char[]> Data;
+        size_t Capacity;
+        size_t Mask;
+
+        // Positions grow monotonically and are masked on access. Head is
+        // written by the consumer, Tail by the producer. They are kept
+        // in separate cache lines
+        alignas(64) std::atomic<size_t> Head;
+        alignas(64) std::atomic<size_t> Tail;
+
+      public:
+        SINCMELNK RingQueue(size_t capacity = LIMIT);
+
+        SINCMELNK size_t GetCapacity() const;
+        SINCMELNK size_t Size() const;
+        SINCMELNK bool IsEmpty() const;
+        SINCMELNK bool GetAvailableLimit(size_t& available) const;
+
+        // Returns contiguous free space or nullptr if the ring is full.
+        // Data written there becomes visible after Commit()
+        SINCMELNK char* Reserve(size_t& size);
+        SINCMELNK void Commit(size_t n);
+
+        // Fails if there is no room for cb bytes
+        SINCMELNK bool Append(const void* p, size_t cb, size_t* qsize = nullptr);
+
+        // Queued data is returned by two spans at most if it wraps
+        SINCMELNK size_t GetSpans(Span* spans, size_t count) const;
+        SINCMELNK void Consume(size_t n);
+
+        // Copies up to cb bytes and removes them from the queue
+        SINCMELNK size_t Read(void* p, size_t cb);
+      };
+    }
+  }
+}
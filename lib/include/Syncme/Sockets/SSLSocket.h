@@ -27,9 +27,11 @@ namespace Syncme
     SINCMELNK int GetFD() const override;
     SINCMELNK void LogIoError(const char* fn, const char* text) override;
     SINCMELNK std::string GetProtocol() const override;
+    SINCMELNK size_t GetObjectSize() const override;
 
   private:
     int InternalWrite(const void* buffer, size_t size, int timeout) override;
+    int InternalWriteV(const Sockets::IO::Span* spans, size_t count) override;
     int InternalRead(void* buffer, size_t size, int timeout) override;
     int ReadPending(void* buffer, size_t size, int i);
     int TranslateSSLError(int n, const char* method);
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 
+#include <list>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -13,9 +14,11 @@
 #include <Syncme/CritSection.h>
 #include <Syncme/Logger/Channel.h>
 #include <Syncme/Logger/Subsystem.h>
+#include <Syncme/Sockets/Async/BufferChain.h>
 #include <Syncme/Sockets/ErrorLimit.h>
 #include <Syncme/Sockets/SocketError.h>
 #include <Syncme/Sockets/Queue.h>
+#include <Syncme/Sockets/Reactor.h>
 #include <Syncme/Sync.h>
 
 #if !defined(_WIN32)
@@ -118,6 +121,15 @@ namespace Syncme
     } f;
   };
 
+  // Memory used by a connection. Buffers are counted by capacity
+  struct SocketMemory
+  {
+    size_t Object;    // size of the socket object
+    size_t RxQueued;  // received data which was not read yet
+    size_t TxQueued;  // data which was not sent yet
+    size_t Cached;    // free buffers kept by the queues
+  };
+
   enum class SocketWaitDirection
   {
     None,
@@ -125,6 +137,26 @@ namespace Syncme
     Write
   };
 
+  // File transfer queued by Socket::SendFile()
+  struct PendingFile
+  {
+    int Fd;           // duplicate of the descriptor passed to SendFile()
+    uint64_t Offset;  // next byte to send
+    uint64_t Left;
+    size_t Before;    // bytes of TxQueue which are sent before the file
+
+    // Window mapped by sockets which can not use sendfile()
+    void* Map;
+    uint64_t MapOffset;
+    size_t MapSize;
+
+    PendingFile(int fd, uint64_t offset, uint64_t length, size_t before);
+    ~PendingFile();
+
+    PendingFile(const PendingFile&) = delete;
+    PendingFile& operator=(const PendingFile&) = delete;
+  };
+
   struct Socket
   {
     SocketPair* Pair;
@@ -158,9 +190,11 @@ namespace Syncme
     int Pid;
 
     Sockets::IO::Queue RxQueue;
+    size_t RxReadSize; // size of the next read in ReadIO()
     Sockets::IO::Queue TxQueue;
     std::mutex IOLock;
     std::mutex TxLock;
+    std::list<PendingFile> TxFiles; // protected by TxLock
 
     bool FailLogged;
 
@@ -184,9 +218,13 @@ namespace Syncme
     int EventDescriptor;
     int EventsMask;
     uint32_t EpollMask;
-#endif
 
-    char RxBuffer[Sockets::IO::BUFFER_SIZE];
+    // Set by "shared_reactor" option. Handle is registered in the shared
+    // reactor and IO() parks on Waiter. Poll and EventDescriptor are not
+    // created
+    bool SharedReactor;
+    Implementation::ReactorWaiter Waiter;
+#endif
 
     enum WaitOrder
     {
@@ -220,10 +258,26 @@ namespace Syncme
     SINCMELNK int Read(std::vector<char>& buffer, int timeout = FOREVER);
     SINCMELNK int Read(void* buffer, size_t size, int timeout = FOREVER);
 
+    // Returns a received buffer without copying. Null is returned if
+    // there is no data, GetLastError() tells the reason. The buffer can
+    // be given back for reuse by ReleaseBuffer()
+    SINCMELNK Sockets::IO::BufferPtr ReadBuffer(int timeout = FOREVER);
+    SINCMELNK void ReleaseBuffer(Sockets::IO::BufferPtr buffer);
+
+    // Adds up to size bytes of received data to the chain without
+    // copying. Returns the number of bytes like Read()
+    SINCMELNK int ReadV(Sockets::Async::BufferChain& chain, size_t size, int timeout = FOREVER);
+
     SINCMELNK int WriteStr(const std::string& str, int timeout = FOREVER, bool* queued = nullptr);
     SINCMELNK int Write(const std::vector<char>& arr, int timeout = FOREVER, bool* queued = nullptr);
     SINCMELNK int Write(const void* buffer, size_t size, int timeout = FOREVER, bool* queued = nullptr);
 
+    // Queues length bytes of the file starting from offset. The file is
+    // sent after data which was written before and before data which is
+    // written later. The descriptor is duplicated, so the caller can close
+    // it. Data is sent by IO() like queued writes
+    SINCMELNK bool SendFile(int fd, uint64_t offset, uint64_t length);
+
     SINCMELNK virtual int GetFD() const = 0;
     SINCMELNK virtual SKT_ERROR Ossl2SktError(int ret) = 0;
     SINCMELNK virtual void LogIoError(const char* fn, const char* text) = 0;
@@ -254,6 +308,9 @@ namespace Syncme
     SINCMELNK void ResetWaitDirection();
     SINCMELNK virtual bool Flush(int timeout = -1);
 
+    SINCMELNK SocketMemory GetMemoryUsage() const;
+    SINCMELNK virtual size_t GetObjectSize() const;
+
     SINCMELNK static const IOCounters& GetTotals();
     
     SINCMELNK static bool IsLoopbackIP(const char* ip);
@@ -279,6 +336,7 @@ namespace Syncme
 
 #if SKTEPOLL
     WAIT_RESULT FastWaitForMultipleObjects(int timeout, IOStat& stat);
+    WAIT_RESULT SharedReactorWait(int timeout);
     WAIT_RESULT EventStateToWaitResult();
     bool UpdateEpollEventList();
 #endif
@@ -305,6 +363,14 @@ namespace Syncme
 
     virtual int InternalWrite(const void* buffer, size_t size, int timeout) = 0;
 
+    // Sends queued spans by one call if the transport allows it. Returns
+    // the number of bytes sent, 0 if the call would block or -1
+    virtual int InternalWriteV(const Sockets::IO::Span* spans, size_t count);
+
+    // Sends a part of the file. Returns the number of bytes, 0 if the
+    // call would block or -1. Default one maps the file and writes it
+    virtual int InternalSendFile(PendingFile& file);
+
 #if defined(_WIN32) && SKTCOUNTERS
     IOCountersGroup& MyCountersGroup();
 #endif
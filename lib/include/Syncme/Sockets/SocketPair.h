@@ -22,6 +22,13 @@ namespace Syncme
     Fast
   };
 
+  // Bytes moved by SocketPair::Relay() in each direction
+  struct RelayStat
+  {
+    uint64_t ClientToServer;
+    uint64_t ServerToClient;
+  };
+
   struct SocketPair
   {
     CHANNEL& CH;
@@ -47,6 +54,9 @@ namespace Syncme
     SINCMELNK int PeerDisconnected();
     SINCMELNK bool IsDisconnected();
 
+    // Memory used by the pair and its sockets
+    SINCMELNK size_t GetMemoryUsage();
+
     SINCMELNK HEvent GetExitEvent() const;
     SINCMELNK HEvent GetCloseEvent() const;
 
@@ -64,9 +74,24 @@ namespace Syncme
     SINCMELNK int Read(std::vector<char>& buffer, SocketPtr& from, int timeout = FOREVER);
     SINCMELNK int Read(void* buffer, size_t size, SocketPtr& from, int timeout = FOREVER);
 
+    // Same as Read() but received buffers are added to the chain instead
+    // of being joined and copied
+    SINCMELNK int ReadV(Sockets::Async::BufferChain& chain, size_t size, SocketPtr& from, int timeout = FOREVER);
+
     SINCMELNK void ResetPendingRead();
 
+    // Moves data between plain (BIOSocket) sockets inside the kernel by
+    // splice() through a pipe till both directions are closed. The end
+    // of data in one direction is passed on by shutdown(SHUT_WR).
+    // Returns false if the exit or close event is set, if no data was
+    // moved during timeout, or on an error. IOLock of both sockets is
+    // held while they are spliced, so the pair must not be used by other
+    // threads during Relay(): their IO() waits for the end of it. Linux
+    // only
+    SINCMELNK bool Relay(RelayStat& stat, int timeout = FOREVER);
+
   private:
-    int IO(SocketPtr socket, void* buffer, size_t size, SocketPtr& from, int timeout);
+    int IO(SocketPtr socket, void* buffer, size_t size, Sockets::Async::BufferChain* chain, SocketPtr& from, int timeout);
+    int ReadInternal(void* buffer, size_t size, Sockets::Async::BufferChain* chain, SocketPtr& from, int timeout);
   };
 }
\ No newline at end of file
@@ -1,12 +1,16 @@
 #pragma once
 
-#include <condition_variable>
+#include <atomic>
 #include <functional>
-#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <stddef.h>
+#include <stdint.h>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <Syncme/Api.h>
 #include <Syncme/Sync.h>
@@ -18,16 +22,82 @@ namespace Syncme
     typedef void (*ItemCallback)(void* context);
     typedef std::function<void()> TCallback;
 
-    struct Item
+    struct Item;
+    typedef std::shared_ptr<Item> ItemPtr;
+
+    class Queue;
+    class Strand;
+    typedef std::shared_ptr<Strand> StrandPtr;
+
+    // Link of an intrusive queue. Node is either an Item or a Strand
+    struct QueueNode
+    {
+      std::atomic<QueueNode*> Next{nullptr};
+      bool IsStrand = false;
+    };
+
+    // Intrusive MPSC queue (D. Vyukov). Push() does not take locks. 
+    // Pop() can be called by one thread at a time
+    class NodeQueue
+    {
+      std::atomic<QueueNode*> Head;
+      QueueNode* Tail;
+      QueueNode Stub;
+
+    public:
+      SINCMELNK NodeQueue();
+
+      SINCMELNK void Push(QueueNode* node);
+
+      // Returns null if the queue is empty or a producer is inside Push()
+      SINCMELNK QueueNode* Pop();
+    };
+
+    // Values of Item::State
+    enum class ITEM_STATE : uint32_t
+    {
+      CREATED,
+      QUEUED,
+      RUNNING,
+      COMPLETED,
+      CANCELLED,
+    };
+
+    // What ScheduleCoalesced() does if an item with the same identifier
+    // is pending
+    enum class COALESCE_MODE
+    {
+      REPLACE,    // the pending item executes the new callback
+      KEEP,       // the new callback is dropped
+    };
+
+    struct Item : QueueNode
     {
+      friend class Queue;
+
       std::string Identifier;
 
       ItemCallback Callback;
       void* Context;
 
       TCallback Functor;
-      HEvent Completed;
-    
+
+      std::atomic<uint32_t> State;
+
+      // Reference which is kept by the queue while the item is queued
+      ItemPtr Self;
+
+      // Time (GetTimeInMillisec) and period of a delayed item. Period is
+      // 0 for one-shot items
+      uint64_t Due;
+      std::atomic<uint32_t> Period;
+
+      // Item is indexed by Queue::Coalesced
+      bool Coalesced;
+
+      // Item is in Queue::Delayed (guarded by Queue::DelayedLock)
+      bool InDelayed;
+
     public:
       SINCMELNK Item(ItemCallback p, void* context, const char* identifier);
       SINCMELNK Item(TCallback functor, const char* identifier);
@@ -37,23 +107,95 @@ namespace Syncme
       SINCMELNK void Cancel();
 
       SINCMELNK void WaitForCompletion() const;
+
+      // Event is created on the first call. It is signalled when the
+      // item is completed or cancelled
+      SINCMELNK HEvent GetCompletedEvent();
+
     private:
       static void DefaultCallback(void* context);
+
+      void Finish(ITEM_STATE state);
+
+      std::mutex EventLock;
+      std::atomic<bool> HasEvent;
+      HEvent Completed;
     };
 
-    typedef std::shared_ptr<Item> ItemPtr;
-    typedef std::list<ItemPtr> ItemList;
+    // Serial sub-queue of Queue. Items of a strand are executed in FIFO
+    // order one at a time by workers of the queue. Idle strand is not
+    // linked to the queue. Strand can outlive its queue: Stop() detaches
+    // strands and their Schedule() cancels items after it. Schedule()
+    // must not race with destruction of the queue
+    class Strand 
+      : public QueueNode
+      , public std::enable_shared_from_this<Strand>
+    {
+      friend class Queue;
+
+      // Null after the queue is stopped
+      std::atomic<Queue*> Owner;
+      NodeQueue Items;
+
+      // Number of scheduled items which were not taken by a worker
+      std::atomic<size_t> Count;
+
+      // Reference which is kept by the queue while the strand is queued
+      StrandPtr Self;
+
+    public:
+      SINCMELNK Strand(Queue* owner);
+      SINCMELNK ~Strand();
+
+      SINCMELNK ItemPtr Schedule(ItemCallback p, void* context, const char* identifier = "");
+      SINCMELNK ItemPtr Schedule(TCallback functor, const char* identifier = "");
+      SINCMELNK ItemPtr Schedule(ItemPtr item);
+
+    private:
+      Item* PopItem();
+    };
 
     class Queue
     {
-      std::mutex Lock;
-      std::condition_variable Wakeup;
-      ItemList Items;
-      bool StopRequested;
-      std::thread Worker;
+      friend class Strand;
+
+      // Producers do not take locks. Consumers are serialized by PopLock
+      NodeQueue Nodes;
+      std::mutex PopLock;
+
+      // Changed on each Schedule() and Stop(). Idle workers wait on it
+      std::atomic<uint32_t> Signal;
+      std::atomic<uint32_t> Sleepers;
+
+      std::atomic<bool> StopRequested;
+      std::vector<std::thread> Workers;
+
+      // Min-heap of delayed items by Item::Due. Cancelled items are
+      // removed when they reach the top or when they are more than half
+      // of the heap. Idle workers sleep till NextDue
+      std::mutex DelayedLock;
+      std::vector<ItemPtr> Delayed;
+      size_t CancelledDelayed;
+      std::atomic<uint64_t> NextDue;
+
+      // Pending items of ScheduleCoalesced() by identifier. An entry is
+      // removed before the item is started
+      std::mutex CoalesceLock;
+      std::unordered_map<std::string, ItemPtr> Coalesced;
+      std::atomic<uint64_t> Merged;
+
+      // Strands created by GetStrand(). They are released when they are
+      // not referenced and have no items
+      std::mutex StrandLock;
+      std::map<std::string, std::weak_ptr<Strand>> Strands;
+      size_t StrandsPruneAt;
+
+      // All strands created by the queue. Stop() detaches them
+      std::vector<std::weak_ptr<Strand>> Owned;
+      size_t OwnedPruneAt;
 
     public:
-      SINCMELNK Queue();
+      SINCMELNK Queue(size_t workers = 1);
       SINCMELNK ~Queue();
 
       SINCMELNK void Stop();
@@ -63,9 +205,50 @@ namespace Syncme
       SINCMELNK ItemPtr Schedule(ItemPtr item);
       SINCMELNK bool Cancel(ItemPtr);
 
+      // If an item with the identifier is pending, the callback is merged
+      // into it instead of scheduling a new one
+      SINCMELNK ItemPtr ScheduleCoalesced(
+        const char* identifier
+        , TCallback functor
+        , COALESCE_MODE mode = COALESCE_MODE::REPLACE
+      );
+
+      // Cancels the pending item of ScheduleCoalesced()
+      SINCMELNK bool Cancel(const std::string& identifier);
+
+      // Number of callbacks merged by ScheduleCoalesced()
+      SINCMELNK uint64_t GetMerged() const;
+
+      // Items are kept in the queue till the time comes. Cancel() of a 
+      // periodic item stops it after the current execution
+      SINCMELNK ItemPtr ScheduleAfter(uint32_t ms, TCallback functor, const char* identifier = "");
+      SINCMELNK ItemPtr ScheduleEvery(uint32_t ms, TCallback functor, const char* identifier = "");
+
+      SINCMELNK StrandPtr CreateStrand();
+
+      // Returns the same strand for the same identifier while it exists
+      SINCMELNK StrandPtr GetStrand(const std::string& identifier);
+
+      // Items with the same identifier are executed in order of the calls
+      // and never overlap. Items with different identifiers run in parallel
+      SINCMELNK ItemPtr ScheduleOrdered(TCallback functor, const char* identifier);
+
+      // Items are allocated from a shared pool of blocks
+      SINCMELNK static ItemPtr CreateItem(ItemCallback p, void* context, const char* identifier = "");
+      SINCMELNK static ItemPtr CreateItem(TCallback functor, const char* identifier = "");
+
     private:
       void WorkerProc();
-      ItemPtr PopItem();
+      void Push(QueueNode* node);
+      QueueNode* PopNode();
+      void RunItem(Item* p);
+      void AddDelayed(ItemPtr item);
+      uint32_t FireDelayed();
+      void Locked_PurgeDelayed();
+      void RunStrand(Strand* p);
+      void CancelAll();
+      StrandPtr Locked_CreateStrand();
+      void DetachStrands();
     };
   }
-}
\ No newline at end of file
+}
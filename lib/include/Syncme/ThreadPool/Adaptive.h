@@ -0,0 +1,97 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <Syncme/Api.h>
+
+namespace Syncme
+{
+  namespace ThreadPool
+  {
+    struct AdaptiveDecision;
+    typedef std::function<void(const AdaptiveDecision&)> TOnDecision;
+
+    struct AdaptiveConfig
+    {
+      bool Enabled = false;
+
+      // Bounds of the thread limit
+      size_t MinThreads = 1;
+      size_t MaxThreads = 100;
+
+      // Time (ms) between decisions
+      uint32_t Interval = 100;
+
+      // Limit is increased while p90 of queueing delay (us) exceeds it
+      uint64_t TargetQueueDelay = 1000;
+
+      // Initial change of the limit. It is doubled while the limit grows
+      // in consecutive intervals
+      size_t Step = 1;
+
+      // Relative drop (percents) of throughput which cancels the last growth
+      uint32_t Tolerance = 10;
+
+      // Number of decisions kept in the trace
+      size_t TraceSize = 256;
+
+      // Called for each decision (for tuning)
+      TOnDecision OnDecision;
+    };
+
+    enum class ADAPT_REASON
+    {
+      IDLE,             // nothing was executed
+      QUEUEING,         // queueing delay is above the target
+      THROUGHPUT_DROP,  // the last growth decreased throughput
+      UNDERUSED,        // the limit is well above the number of busy workers
+      STABLE,
+    };
+
+    // Statistics of one interval
+    struct AdaptiveSample
+    {
+      uint64_t Time;        // ms
+      uint64_t Interval;    // ms
+      uint64_t Completed;   // tasks completed during the interval
+      uint64_t QueueDelay;  // p90 of queueing delay (us)
+      size_t PeakBusy;      // maximal number of busy workers
+    };
+
+    struct AdaptiveDecision
+    {
+      AdaptiveSample Sample;
+      double Throughput;    // tasks per second
+      size_t Limit;         // new thread limit
+      int64_t Change;
+      ADAPT_REASON Reason;
+    };
+
+    // Hill climbing controller of the thread limit. Pool passes it 
+    // statistics once per AdaptiveConfig::Interval
+    class AdaptiveController
+    {
+      AdaptiveConfig Config;
+
+      size_t Limit;
+      size_t Step;
+      int64_t LastChange;
+      double LastThroughput;
+
+      std::deque<AdaptiveDecision> Trace;
+
+    public:
+      SINCMELNK AdaptiveController(const AdaptiveConfig& config = AdaptiveConfig());
+
+      SINCMELNK const AdaptiveConfig& GetConfig() const;
+      SINCMELNK size_t GetLimit() const;
+
+      SINCMELNK AdaptiveDecision Update(const AdaptiveSample& sample);
+      SINCMELNK std::vector<AdaptiveDecision> GetTrace() const;
+    };
+  }
+}
@@ -28,6 +28,11 @@ namespace Syncme
     SINCMELNK uint64_t GetSlowInvoke();
     SINCMELNK uint64_t GetCreateInvoke();
 
+    // Keyed tasks which were executed by the worker of the previous task
+    // with the same key / were taken by another worker
+    SINCMELNK uint64_t GetAffineInvoke();
+    SINCMELNK uint64_t GetAffineSteal();
+
     SINCMELNK uint64_t GetLockedInRunCreateWorker();
     SINCMELNK uint64_t GetLockedInRunStop();
     SINCMELNK uint64_t GetLockedInRunFail();
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <Syncme/Sync.h>
+
+namespace Syncme
+{
+  template<typename T> class Future;
+  template<typename T> class Promise;
+
+  namespace Implementation
+  {
+    template<typename T>
+    struct FutureValue
+    {
+      std::optional<T> Value;
+    };
+
+    template<>
+    struct FutureValue<void>
+    {
+    };
+
+    template<typename T>
+    struct FutureState : public FutureValue<T>
+    {
+      std::mutex Lock;
+      bool Ready = false;
+      std::exception_ptr Error;
+
+      // Created on demand. Chains of continuations do not need any event objects
+      HEvent Completed;
+      std::vector<std::function<void()>> Continuations;
+
+      HEvent Handle()
+      {
+        std::lock_guard guard(Lock);
+
+        if (Completed == nullptr)
+        {
+          Completed = CreateNotificationEvent(
+            Ready ? STATE::SIGNALLED : STATE::NOT_SIGNALLED
+          );
+        }
+
+        return Completed;
+      }
+
+      bool IsReady()
+      {
+        std::lock_guard guard(Lock);
+        return Ready;
+      }
+
+      template<typename... Args>
+      bool SetValue(Args&&... args)
+      {
+        std::unique_lock guard(Lock);
+        if (Ready)
+          return false;
+
+        if constexpr (!std::is_void_v<T>)
+          this->Value.emplace(std::forward<Args>(args)...);
+
+        Finish(guard);
+        return true;
+      }
+
+      bool SetError(std::exception_ptr error)
+      {
+        std::unique_lock guard(Lock);
+        if (Ready)
+          return false;
+
+        Error = error;
+
+        Finish(guard);
+        return true;
+      }
+
+      // Continuation is called immediately if the state is already completed.
+      // Otherwise it is called by the thread which completes the state
+      void OnReady(std::function<void()> f)
+      {
+        if (true)
+        {
+          std::lock_guard guard(Lock);
+
+          if (!Ready)
+          {
+            Continuations.push_back(std::move(f));
+            return;
+          }
+        }
+
+        f();
+      }
+
+    private:
+      void Finish(std::unique_lock<std::mutex>& guard)
+      {
+        Ready = true;
+
+        std::vector<std::function<void()>> continuations;
+        continuations.swap(Continuations);
+
+        HEvent completed = Completed;
+        guard.unlock();
+
+        if (completed)
+          SetEvent(completed);
+
+        for (auto& c : continuations)
+          c();
+      }
+    };
+
+    template<typename T, typename F>
+    struct ThenResult
+    {
+      typedef std::invoke_result_t<F&, T&> Type;
+    };
+
+    template<typename F>
+    struct ThenResult<void, F>
+    {
+      typedef std::invoke_result_t<F&> Type;
+    };
+  }
+
+  template<typename T>
+  class Promise
+  {
+    typedef Implementation::FutureState<T> State;
+    std::shared_ptr<State> S;
+
+  public:
+    Promise()
+      : S(std::make_shared<State>())
+    {
+    }
+
+    Future<T> GetFuture() const
+    {
+      return Future<T>(S);
+    }
+
+    // Only the first SetValue() / SetException() call has effect
+    template<typename... Args>
+    bool SetValue(Args&&... args) const
+    {
+      return S->SetValue(std::forward<Args>(args)...);
+    }
+
+    bool SetException(std::exception_ptr error) const
+    {
+      return S->SetError(error);
+    }
+
+    // Calls f and stores either its result or the exception thrown by it
+    template<typename F, typename... Args>
+    bool SetFrom(F& f, Args&... args) const
+    {
+      try
+      {
+        if constexpr (std::is_void_v<T>)
+        {
+          f(args...);
+          return SetValue();
+        }
+        else
+          return SetValue(f(args...));
+      }
+      catch (...)
+      {
+        return SetException(std::current_exception());
+      }
+    }
+  };
+
+  template<typename T>
+  class Future
+  {
+    typedef Implementation::FutureState<T> State;
+    std::shared_ptr<State> S;
+
+    template<typename> friend class Future;
+    template<typename> friend class Promise;
+
+    template<typename U>
+    friend auto WhenAll(const std::vector<Future<U>>& futures);
+
+    template<typename U>
+    friend Future<size_t> WhenAny(const std::vector<Future<U>>& futures);
+
+    explicit Future(std::shared_ptr<State> state)
+      : S(state)
+    {
+    }
+
+  public:
+    Future() = default;
+
+    bool Valid() const
+    {
+      return S != nullptr;
+    }
+
+    bool IsReady() const
+    {
+      return S && S->IsReady();
+    }
+
+    // The event is signalled when the future is completed. It can be
+    // used with WaitForSingleObject() / WaitForMultipleObjects()
+    HEvent Handle() const
+    {
+      return S ? S->Handle() : HEvent();
+    }
+
+    operator HEvent() const
+    {
+      return Handle();
+    }
+
+    WAIT_RESULT Wait(uint32_t ms = FOREVER) const
+    {
+      if (S == nullptr)
+        return WAIT_RESULT::FAILED;
+
+      if (S->IsReady())
+        return WAIT_RESULT::OBJECT_0;
+
+      return WaitForSingleObject(S->Handle(), ms);
+    }
+
+    // Waits for completion. Rethrows exception if the task failed.
+    // Throws std::future_error if the future has no state
+    T Get() const
+    {
+      if (!Valid())
+        throw std::future_error(std::future_errc::no_state);
+
+      Wait();
+
+      if (S->Error)
+        std::rethrow_exception(S->Error);
+
+      if constexpr (!std::is_void_v<T>)
+        return *S->Value;
+    }
+
+    // Continuation is called inline by the thread which completes this
+    // future (or by the caller if it is already completed). It is
+    // supposed to be cheap. Exception is propagated without calling f
+    template<typename F>
+    auto Then(F f) const
+    {
+      typedef typename Implementation::ThenResult<T, F>::Type R;
+
+      if (!Valid())
+        throw std::future_error(std::future_errc::no_state);
+
+      Promise<R> promise;
+      Future<R> next = promise.GetFuture();
+
+      // Continuation is stored inside of the state. Raw pointer is
+      // used to avoid reference cycle
+      State* source = S.get();
+
+      S->OnReady(
+        [source, promise, f]() mutable
+        {
+          if (source->Error)
+            promise.SetException(source->Error);
+          else if constexpr (std::is_void_v<T>)
+            promise.SetFrom(f);
+          else
+            promise.SetFrom(f, *source->Value);
+        }
+      );
+
+      return next;
+    }
+  };
+
+  // Completed when all futures are completed. The first exception (in
+  // order of the futures) is propagated
+  template<typename T>
+  auto WhenAll(const std::vector<Future<T>>& futures)
+  {
+    typedef std::conditional_t<std::is_void_v<T>, void, std::vector<T>> R;
+
+    struct Context
+    {
+      std::vector<Future<T>> Futures;
+      std::atomic<size_t> Remaining;
+      Promise<R> Result;
+    };
+
+    auto context = std::make_shared<Context>();
+    context->Futures = futures;
+    context->Remaining = futures.size();
+
+    Future<R> result = context->Result.GetFuture();
+    if (futures.empty())
+    {
+      context->Result.SetValue();
+      return result;
+    }
+
+    for (auto& f : futures)
+    {
+      f.S->OnReady(
+        [context]()
+        {
+          if (--context->Remaining)
+            return;
+
+          for (auto& e : context->Futures)
+          {
+            if (e.S->Error)
+            {
+              context->Result.SetException(e.S->Error);
+              return;
+            }
+          }
+
+          if constexpr (std::is_void_v<T>)
+            context->Result.SetValue();
+          else
+          {
+            R values;
+            values.reserve(context->Futures.size());
+
+            for (auto& e : context->Futures)
+              values.push_back(*e.S->Value);
+
+            context->Result.SetValue(std::move(values));
+          }
+
+          context->Futures.clear();
+        }
+      );
+    }
+
+    return result;
+  }
+
+  // Completed with index of the first completed future. Fails at once
+  // if there are no futures
+  template<typename T>
+  Future<size_t> WhenAny(const std::vector<Future<T>>& futures)
+  {
+    Promise<size_t> promise;
+    Future<size_t> result = promise.GetFuture();
+
+    if (futures.empty())
+    {
+      promise.SetException(
+        std::make_exception_ptr(std::invalid_argument("WhenAny() of no futures"))
+      );
+      return result;
+    }
+
+    for (size_t i = 0; i < futures.size(); ++i)
+      futures[i].S->OnReady([promise, i]() { promise.SetValue(i); });
+
+    return result;
+  }
+}
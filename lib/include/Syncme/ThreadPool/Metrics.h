@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Syncme/Histogram.h>
+
+namespace Syncme
+{
+  namespace ThreadPool
+  {
+    // Times are in microseconds
+    struct MetricsSnapshot
+    {
+      HistogramSnapshot QueueDelay;   // from Run() call till start of the task
+      HistogramSnapshot RunTime;      // execution of the callback
+      HistogramSnapshot RunOverhead;  // duration of Run() call
+    };
+
+    struct TaskMetrics
+    {
+      Histogram QueueDelay;
+      Histogram RunTime;
+      Histogram RunOverhead;
+
+      MetricsSnapshot Snapshot(bool reset)
+      {
+        MetricsSnapshot s;
+
+        if (reset)
+        {
+          s.QueueDelay = QueueDelay.SnapshotAndReset();
+          s.RunTime = RunTime.SnapshotAndReset();
+          s.RunOverhead = RunOverhead.SnapshotAndReset();
+        }
+        else
+        {
+          s.QueueDelay = QueueDelay.Snapshot();
+          s.RunTime = RunTime.Snapshot();
+          s.RunOverhead = RunOverhead.Snapshot();
+        }
+
+        return s;
+      }
+    };
+  }
+}
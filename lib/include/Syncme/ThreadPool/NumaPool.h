@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <Syncme/Api.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+namespace Syncme
+{
+  namespace ThreadPool
+  {
+    // Set of pools, one per NUMA node. Workers of a pool are bound to
+    // CPUs of its node. Run() submits a task to the pool of the node 
+    // the calling thread is running on, so objects allocated by the 
+    // caller stay local to the worker
+    class NumaPool
+    {
+      std::vector<std::unique_ptr<Pool>> Nodes;
+
+    public:
+      SINCMELNK NumaPool(AFFINITY_MODE mode = AFFINITY_MODE::SHARED);
+      SINCMELNK ~NumaPool();
+
+      SINCMELNK void Stop();
+
+      SINCMELNK size_t GetNodeCount() const;
+      SINCMELNK Pool& GetNode(size_t node);
+      SINCMELNK Pool& GetLocalNode();
+
+      SINCMELNK HEvent Run(TCallback cb, uint64_t* pid = nullptr);
+      SINCMELNK HEvent Run(size_t node, TCallback cb, uint64_t* pid = nullptr);
+
+    private:
+      NumaPool(const NumaPool&) = delete;
+      NumaPool& operator=(const NumaPool&) = delete;
+    };
+  }
+}
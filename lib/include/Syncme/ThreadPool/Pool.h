@@ -1,36 +1,126 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <stdint.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
+#include <Syncme/Affinity.h>
 #include <Syncme/Api.h>
+#include <Syncme/Histogram.h>
 #include <Syncme/TimePoint.h>
+#include <Syncme/ThreadPool/Adaptive.h>
+#include <Syncme/ThreadPool/Future.h>
+#include <Syncme/ThreadPool/Metrics.h>
 #include <Syncme/ThreadPool/Worker.h>
+#include <Syncme/ThreadPool/WorkerList.h>
 
 namespace Syncme
 {
   namespace ThreadPool
   {
-    typedef std::list<WorkerPtr> WorkerList;
     typedef std::function<void(size_t)> SCompact;
 
+    // Processes range [begin, end)
+    typedef std::function<void(size_t, size_t)> TChunk;
+
+    // Called with true when number of queued tasks reaches the high 
+    // water mark and with false when it drops to half of it
+    typedef std::function<void(bool, size_t)> TBackpressure;
+
     enum class OVERFLOW_MODE
     {
       FAIL,
-      WAIT
+      WAIT,
+      QUEUE       // keep the task queued till a worker is free. Run() does not block
+    };
+
+    enum class AFFINITY_MODE
+    {
+      SHARED,     // each worker can run on any CPU of the set
+      PER_CORE,   // each worker is bound to one CPU of the set
+    };
+
+    // Queueing delay (from Run() call till start of execution) of tasks 
+    // submitted to a lane. Times are in microseconds
+    struct LaneStats
+    {
+      uint64_t Submitted;
+      uint64_t Started;
+      uint64_t Expired;
+      uint64_t Demoted;
+      uint64_t TotalDelay;
+      uint64_t MaxDelay;
     };
 
     class Pool
     {
       size_t MaxUnusedThreads;
       size_t MaxThreads;
+      size_t MinThreads;
       long MaxIdleTime;
+      size_t StackSize;
       OVERFLOW_MODE Mode;
+
+      size_t QueueCapacity;
+      size_t HighWater;
+      TBackpressure Backpressure;
+      std::atomic<bool> BackpressureOn;
       SCompact Compact;
+      size_t CompactPercent;
+      size_t CompactStep;
+
+      // MaxThreads or the limit chosen by the adaptive controller
+      std::atomic<size_t> ThreadLimit;
+
+      std::atomic<bool> Adaptive;
+      uint32_t AdaptInterval;
+      std::mutex AdaptLock;
+      AdaptiveController Controller;
+      uint64_t LastSample;
+      std::atomic<uint64_t> NextSample;
+      std::atomic<uint64_t> Completed;
+      std::atomic<size_t> PeakBusy;
+      Histogram AdaptDelay;
+
+      CpuSet Affinity;
+      AFFINITY_MODE AffinityMode;
+
+      // Number of workers bound to each CPU of Affinity in PER_CORE mode
+      std::vector<size_t> CpuLoad;
+
+      // Workers which can not be used by less urgent lanes
+      size_t Reserved[PRIORITY_COUNT];
+
+      struct LaneCounters
+      {
+        std::atomic<uint64_t> Submitted;
+        std::atomic<uint64_t> Started;
+        std::atomic<uint64_t> Expired;
+        std::atomic<uint64_t> Demoted;
+        std::atomic<uint64_t> TotalDelay;
+        std::atomic<uint64_t> MaxDelay;
+      };
+
+      LaneCounters Lanes[PRIORITY_COUNT];
+
+      TaskMetrics Metrics;
+
+      // Metrics of tagged tasks. Objects are not deleted till the pool
+      // is destroyed, so tasks keep raw pointers to them
+      std::mutex TagLock;
+      std::map<std::string, std::unique_ptr<TaskMetrics>> Tags;
 
-      HEvent Timer;
       HEvent FreeEvent;
       HEvent StopEvent;
 
@@ -38,11 +128,41 @@ namespace Syncme
       uint64_t Owner;
       bool Stopping;
 
-      WorkerList All;
-      WorkerList Unused;
+      // All.Size() - Unused.Size(). Updated under Lock
+      std::atomic<size_t> Busy;
+
+      WorkerList<&Worker::AllHook> All;
+
+      // LIFO stack. The most recently used worker is reused first, 
+      // workers at the bottom expire first
+      WorkerList<&Worker::UnusedHook> Unused;
 
       std::mutex TaskLock;
-      TaskList Tasks;
+      TaskList Tasks[PRIORITY_COUNT];
+
+      // Number of tasks in Tasks and number of QueueTask() calls. Both
+      // are changed under TaskLock
+      std::atomic<size_t> PendingTasks;
+      std::atomic<uint64_t> QueueSeq;
+
+      struct KeyedItem
+      {
+        TCallback Callback;
+        HEvent Completed;
+      };
+
+      // Tasks of one key are executed one by one by a single drain
+      // callback. Home is the worker which executed the last of them
+      struct KeyState
+      {
+        std::weak_ptr<Worker> Home;
+        std::deque<KeyedItem> Pending;
+        bool Active = false;
+      };
+
+      std::mutex KeyLock;
+      std::unordered_map<uint64_t, KeyState> Keys;
+      size_t KeysPruneAt;
 
     public:
       SINCMELNK Pool();
@@ -51,6 +171,110 @@ namespace Syncme
       SINCMELNK void Stop();
 
       SINCMELNK HEvent Run(TCallback cb, uint64_t* pid = nullptr);
+      SINCMELNK HEvent Run(
+        TCallback cb
+        , const RunOptions& options
+        , uint64_t* pid = nullptr
+      );
+
+      // Tasks with the same key are executed in order of Run() calls and
+      // never overlap. They are executed by the worker of the previous
+      // task while it is alive. If it is busy, any free worker is used
+      SINCMELNK HEvent Run(uint64_t key, TCallback cb);
+
+      // Releases the state of the key. Pending tasks are not affected
+      SINCMELNK void ForgetKey(uint64_t key);
+
+      // Submits all callbacks taking Pool locks once per dispatch round.
+      // Returns number of accepted tasks. If completion is not null, it 
+      // receives an event signalled after all accepted tasks are completed
+      SINCMELNK size_t RunBatch(
+        std::span<const TCallback> batch
+        , HEvent* completion = nullptr
+      );
+
+      // Runs f in the pool. Result (or exception) of f is passed
+      // through the returned future
+      template<typename F>
+      auto Submit(F f, const RunOptions& options = RunOptions())
+      {
+        typedef std::invoke_result_t<F&> R;
+
+        Promise<R> promise;
+        Future<R> future = promise.GetFuture();
+
+        // In OVERFLOW_MODE::QUEUE the task can be dropped after Run()
+        // has returned the handle. Handler of the caller is kept
+        RunOptions opt = options;
+        opt.OnDrop = [promise, onDrop = options.OnDrop]()
+        {
+          promise.SetException(
+            std::make_exception_ptr(std::runtime_error("task was dropped by thread pool"))
+          );
+
+          if (onDrop)
+            onDrop();
+        };
+
+        HEvent h = Run([promise, f]() mutable { promise.SetFrom(f); }, opt);
+        if (h == nullptr)
+        {
+          promise.SetException(
+            std::make_exception_ptr(std::runtime_error("task was rejected by thread pool"))
+          );
+        }
+
+        return future;
+      }
+
+      // Calls fn for chunks of [first, last) in parallel. Chunks are 
+      // claimed from a shared counter by idle workers and by the caller, 
+      // so the call never waits for a free worker. Returns when all chunks
+      // are completed. The first exception thrown by fn is rethrown.
+      // If grain is 0, it is chosen to get about 8 chunks per thread
+      SINCMELNK void ParallelFor(
+        size_t first
+        , size_t last
+        , size_t grain
+        , const TChunk& fn
+      );
+
+      // fn(begin, end) returns result for a chunk. Results are combined
+      // by reduce in order of chunks, so reduce has to be associative only
+      template<typename T, typename F, typename R>
+      T ParallelReduce(
+        size_t first
+        , size_t last
+        , size_t grain
+        , T identity
+        , F fn
+        , R reduce
+      )
+      {
+        if (first >= last)
+          return identity;
+
+        grain = GetGrain(last - first, grain);
+
+        std::vector<T> partial((last - first + grain - 1) / grain, identity);
+        ParallelFor(
+          first
+          , last
+          , grain
+          , [&](size_t begin, size_t end)
+          {
+            partial[(begin - first) / grain] = fn(begin, end);
+          }
+        );
+
+        T result = identity;
+        for (auto& p : partial)
+          result = reduce(result, p);
+
+        return result;
+      }
+
+      SINCMELNK size_t GetGrain(size_t count, size_t grain) const;
 
       SINCMELNK void StopUnused();
 
@@ -63,23 +287,84 @@ namespace Syncme
       SINCMELNK long GetMaxIdleTime() const;
       SINCMELNK void SetMaxIdleTime(long t);
 
+      // Workers which are kept alive even if they are idle. Missing
+      // workers are started at once without waiting for each other
+      SINCMELNK size_t GetMinThreads() const;
+      SINCMELNK void SetMinThreads(size_t n);
+
+      // Stack size of workers created after the call. 0 means default
+      SINCMELNK size_t GetStackSize() const;
+      SINCMELNK void SetStackSize(size_t size);
+
       SINCMELNK OVERFLOW_MODE GetOverflowMode() const;
       SINCMELNK void SetOverflowMode(OVERFLOW_MODE mode);
 
+      // Limits of OVERFLOW_MODE::QUEUE. Run() fails if there are more 
+      // than capacity queued tasks
+      SINCMELNK void SetQueueLimits(
+        size_t capacity
+        , size_t highWater
+        , TBackpressure cb = TBackpressure()
+      );
+      SINCMELNK size_t GetPendingTasks() const;
+
       SINCMELNK void SetCompact(SCompact compact);
 
+      // Compact callback is called when percent of MaxThreads is busy. It 
+      // is asked to free workers to get (percent - step) busy
+      SINCMELNK void SetCompactThreshold(size_t percent, size_t step);
+
+      // Thread limit is chosen by measured queueing delay and throughput
+      // in bounds of the config. MaxThreads is not used while it is enabled.
+      // Decisions are made by threads which call Run() or complete tasks
+      SINCMELNK void SetAdaptive(const AdaptiveConfig& config);
+      SINCMELNK AdaptiveConfig GetAdaptive();
+      SINCMELNK std::vector<AdaptiveDecision> GetAdaptiveTrace();
+      SINCMELNK size_t GetThreadLimit() const;
+
+      // Number of workers which can be used only by tasks of the lane and
+      // more urgent lanes. Each lane can use at least one worker
+      SINCMELNK size_t GetReservedThreads(PRIORITY lane) const;
+      SINCMELNK void SetReservedThreads(PRIORITY lane, size_t n);
+
+      SINCMELNK LaneStats GetLaneStats(PRIORITY lane) const;
+
+      // Histograms of all tasks / tasks with the tag. They can be read 
+      // (and reset) while the pool is running
+      SINCMELNK MetricsSnapshot GetMetrics(bool reset = false);
+      SINCMELNK MetricsSnapshot GetTagMetrics(const std::string& tag, bool reset = false);
+      SINCMELNK std::vector<std::string> GetTags();
+
+      // Affects workers which are created after the call. In PER_CORE
+      // mode a new worker is bound to the least loaded CPU, so with
+      // MaxThreads equal to cpus.size() there is one worker per core
+      SINCMELNK void SetAffinity(
+        const CpuSet& cpus
+        , AFFINITY_MODE mode = AFFINITY_MODE::SHARED
+      );
+      SINCMELNK CpuSet GetAffinity() const;
+      SINCMELNK AFFINITY_MODE GetAffinityMode() const;
+
     private:
       TaskPtr CB_OnFree(Worker* p);
       void CB_OnTimer(Worker* p);
 
       void DoCompact();
+      void Adapt();
+      void Prespawn();
 
       void SetStopping();
-      WorkerPtr PopUnused(size_t& allCount);
-      void Push(WorkerList& list, WorkerPtr t);
+      WorkerPtr PopUnused(PRIORITY lane, bool& full);
+      size_t PopUnused(size_t count, std::vector<WorkerPtr>& idle);
+      void PushAll(WorkerPtr t);
+      void PushUnused(WorkerPtr t);
 
       void Locked_StopExpired(Worker* caller);
+      void Locked_StopWorker(Worker* p);
       void Locked_Find(Worker* p, bool& all, bool& unused);
+      void Locked_UpdateCounters();
+      void Locked_Bind(Worker* p);
+      void Locked_Unbind(Worker* p);
       
       WorkerPtr CreateWorker(
         const TimePoint& t0
@@ -88,10 +373,29 @@ namespace Syncme
         , HEvent& thread
       );
 
-      TaskPtr QueueTask(TCallback cb);
+      size_t GetLimit(PRIORITY lane) const;
+      uint32_t GetWaitTime(TaskPtr task);
+      void TaskStarted(const TaskPtr& task);
+      TaskMetrics* FindTagMetrics(const std::string& tag);
+
+      TaskPtr QueueTask(TCallback cb, const RunOptions& options);
       bool DequeueTask(TaskPtr task);
+      void RequeueTask(TaskPtr task);
+      bool ExpireTask(TaskPtr task);
+      void Locked_Demote(TaskPtr task);
+      TaskPtr Locked_PopTask(TaskList& expired);
+      void DequeueTasks(TaskList& pending, size_t count, std::vector<TaskPtr>& claimed);
+
+      bool Run2(uint64_t* pid, HEvent& h, TaskPtr task, TimePoint& t0, bool& deferred);
+      size_t RunBatch2(std::span<const TCallback> batch, HEvent* completion, OVERFLOW_MODE mode);
+      void CheckBackpressure();
+      void DropQueued();
 
-      bool Run2(uint64_t* pid, HEvent& h, TaskPtr task, TimePoint& t0);
+      WorkerPtr TakeUnused(Worker* p);
+      bool DispatchKey(uint64_t key, WorkerPtr home);
+      void DrainKey(uint64_t key);
+      void DropKeyed();
+      void Locked_PruneKeys();
     };
   }
 }
\ No newline at end of file
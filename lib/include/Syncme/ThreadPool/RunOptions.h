@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+namespace Syncme
+{
+  namespace ThreadPool
+  {
+    // Tasks of a more urgent lane are taken by free workers first
+    enum class PRIORITY
+    {
+      HIGH,
+      NORMAL,
+      LOW
+    };
+
+    constexpr static size_t PRIORITY_COUNT = 3;
+
+    // What to do with a task which waited for a worker longer than 
+    // its deadline
+    enum class DEADLINE_POLICY
+    {
+      DROP,       // Run() returns null handle, the task is not executed
+      DEMOTE,     // the task is moved to LOW lane and waits without deadline
+    };
+
+    struct RunOptions
+    {
+      PRIORITY Priority = PRIORITY::NORMAL;
+
+      // Maximal time (ms) the task can wait for a worker. 0 - no deadline
+      uint32_t Deadline = 0;
+      DEADLINE_POLICY Policy = DEADLINE_POLICY::DROP;
+
+      // Metrics of tasks with not empty tag are collected separately
+      // in addition to the pool metrics. See Pool::GetTagMetrics()
+      std::string Tag;
+
+      // Called if the task is removed from the queue without execution:
+      // by Stop() or by the deadline after Run() has returned
+      std::function<void()> OnDrop;
+    };
+  }
+}
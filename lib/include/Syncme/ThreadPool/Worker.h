@@ -1,14 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <list>
 #include <memory>
+#include <stddef.h>
 #include <stdint.h>
-#include <thread>
 
+#include <Syncme/Affinity.h>
 #include <Syncme/Api.h>
-#include <Syncme/CritSection.h>
 #include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/RunOptions.h>
 
 namespace Syncme
 {
@@ -17,6 +19,8 @@ namespace Syncme
     class Worker;
     typedef std::shared_ptr<Worker> WorkerPtr;
 
+    struct TaskMetrics;
+
     typedef std::function<void(void)> TCallback;
 
     struct Task
@@ -24,6 +28,30 @@ namespace Syncme
       TCallback Callback;
       WorkerPtr Worker;
       HEvent ThreadHandle;
+
+      // Position in Pool::Tasks. Valid while Queued is true (guarded by Pool::TaskLock)
+      bool Queued = false;
+      std::list<std::shared_ptr<Task>>::iterator Position;
+
+      // Lane of submission (used for statistics) and current lane. The 
+      // last one can be changed by DEADLINE_POLICY::DEMOTE
+      PRIORITY Lane = PRIORITY::NORMAL;
+      std::atomic<PRIORITY> Priority = PRIORITY::NORMAL;
+
+      // Time of Run() call and deadline in microseconds. Deadline is 0 
+      // if the task can wait forever (guarded by Pool::TaskLock)
+      uint64_t Submitted = 0;
+      uint64_t Deadline = 0;
+      DEADLINE_POLICY Policy = DEADLINE_POLICY::DROP;
+
+      // Task was dropped because of deadline (guarded by Pool::TaskLock)
+      bool Expired = false;
+
+      // Metrics of the task tag. Null if the task has no tag
+      TaskMetrics* Metrics = nullptr;
+
+      // Called if the task is removed from the queue without execution
+      TCallback OnDrop;
     };
 
     typedef std::shared_ptr<Task> TaskPtr;
@@ -32,20 +60,38 @@ namespace Syncme
     typedef std::function<TaskPtr(Worker*)> TOnIdle;
     typedef std::function<void(Worker*)> TOnTimer;
 
+    // Links of a worker in an intrusive WorkerList. The list keeps a
+    // reference to the worker while it is linked
+    struct WorkerHook
+    {
+      Worker* Prev = nullptr;
+      Worker* Next = nullptr;
+      WorkerPtr Ref;
+    };
+
+    // Values of Worker::State
+    enum class WORKER_STATE : uint32_t
+    {
+      STARTING,   // thread is created, ThreadID is not yet known
+      BUSY,       // callback is being executed
+      IDLE,       // worker is looking for a task or handles idle timeout
+      PARKED,     // worker sleeps in FutexWait() on State
+      INVOKED,    // Callback was assigned by Invoke(), worker has to run it
+      STOPPING,   // Stop() was called
+    };
 
     class Worker : public std::enable_shared_from_this<Worker>
     {
-      HEvent ManagementTimer;
+      // Single state word. Handoff of a task to a parked worker is one 
+      // atomic exchange and one futex wake
+      std::atomic<uint32_t> State;
 
-      HEvent StartedEvent;
-      HEvent StopEvent;
-      HEvent IdleEvent;
-      HEvent BusyEvent;
-      HEvent InvokeEvent;
-      HEvent ExpireTimer;
+      // Native thread is created directly to be able to set stack size
+      struct NativeThread;
 
       uint64_t ThreadID;
-      std::shared_ptr<std::thread> Thread;
+      std::unique_ptr<NativeThread> Thread;
+      size_t StackSize;
       
       bool Started;
       bool Stopped;
@@ -55,31 +101,69 @@ namespace Syncme
       TOnTimer OnTimer;
       TCallback Callback;
 
-      CS StateLock;
+      // Emulates thread handle. Signalled when Callback is completed
+      HEvent Completion;
+
+      // Time when the worker was put to the list of unused workers
+      uint64_t IdleSince;
+
+      // How long parked worker sleeps before OnTimer is called. Used only
+      // by the worker thread
+      uint32_t IdleTimeout;
+
+      // Execution time (microseconds) of the last callback
+      uint64_t LastRunTime;
+
+      // Number of executed callbacks
+      uint64_t Executed;
+
+      // CPUs the thread is bound to. Runtime affinity is used if empty
+      CpuSet Affinity;
+
+    public:
+      // Guarded by Pool::Lock
+      WorkerHook AllHook;
+      WorkerHook UnusedHook;
 
     public:
       SINCMELNK Worker(
-        HEvent managementTimer
-        , TOnIdle notifyIdle
+        TOnIdle notifyIdle
         , TOnTimer onTimer
       );
       SINCMELNK ~Worker();
 
+      // If cb is empty, the worker becomes idle right after start.
+      // The returned event is signalled in this case
       SINCMELNK HEvent Start(TCallback cb, uint64_t* id);
       SINCMELNK void Stop();
 
       SINCMELNK HEvent Invoke(TCallback cb, uint64_t& id);
       SINCMELNK WorkerPtr Get();
 
-      SINCMELNK void SetExpireTimer(long ms);
-      SINCMELNK void CancelExpireTimer();
-      SINCMELNK bool IsExpired() const;
+      SINCMELNK void SetIdleSince(uint64_t t);
+      SINCMELNK uint64_t GetIdleSince() const;
+
+      // Can be called only from NotifyIdle / OnTimer callbacks
+      SINCMELNK void SetIdleTimeout(uint32_t ms);
+
+      // Has to be called before Start()
+      SINCMELNK void SetAffinity(const CpuSet& cpus);
+      SINCMELNK const CpuSet& GetAffinity() const;
+
+      // Has to be called before Start(). 0 means default stack size
+      SINCMELNK void SetStackSize(size_t size);
+
+      // Worker of the calling thread. Null if it is not a pool thread
+      SINCMELNK static Worker* GetCurrent();
 
       SINCMELNK uint64_t GetTid() const;
-      SINCMELNK HEvent Handle();
+      SINCMELNK uint64_t GetLastRunTime() const;
+      SINCMELNK uint64_t GetExecuted() const;
 
     private:
       void EntryPoint();
+      void Execute();
+      bool WaitForInvoke();
     };
   }
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cassert>
+#include <stddef.h>
+
+#include <Syncme/ThreadPool/Worker.h>
+
+namespace Syncme
+{
+  namespace ThreadPool
+  {
+    // Intrusive doubly linked list of workers. Links are stored in the
+    // worker (see WorkerHook), so insertion and removal are O(1) and do
+    // not allocate memory. A worker can be linked to several lists at
+    // the same time if they use different hooks
+    template<WorkerHook Worker::* Hook>
+    class WorkerList
+    {
+      Worker* Head;
+      Worker* Tail;
+      size_t Count;
+
+    public:
+      WorkerList()
+        : Head(nullptr)
+        , Tail(nullptr)
+        , Count(0)
+      {
+      }
+
+      ~WorkerList()
+      {
+        Clear();
+      }
+
+      bool Empty() const
+      {
+        return Count == 0;
+      }
+
+      size_t Size() const
+      {
+        return Count;
+      }
+
+      Worker* Front() const
+      {
+        return Head;
+      }
+
+      Worker* Back() const
+      {
+        return Tail;
+      }
+
+      static Worker* Next(Worker* p)
+      {
+        return (p->*Hook).Next;
+      }
+
+      static Worker* Prev(Worker* p)
+      {
+        return (p->*Hook).Prev;
+      }
+
+      static bool Contains(Worker* p)
+      {
+        return (p->*Hook).Ref != nullptr;
+      }
+
+      void PushFront(WorkerPtr t)
+      {
+        WorkerHook& h = t.get()->*Hook;
+        assert(h.Ref == nullptr);
+
+        h.Prev = nullptr;
+        h.Next = Head;
+
+        if (Head)
+          (Head->*Hook).Prev = t.get();
+        else
+          Tail = t.get();
+
+        Head = t.get();
+        h.Ref = t;
+        Count++;
+      }
+
+      void PushBack(WorkerPtr t)
+      {
+        WorkerHook& h = t.get()->*Hook;
+        assert(h.Ref == nullptr);
+
+        h.Prev = Tail;
+        h.Next = nullptr;
+
+        if (Tail)
+          (Tail->*Hook).Next = t.get();
+        else
+          Head = t.get();
+
+        Tail = t.get();
+        h.Ref = t;
+        Count++;
+      }
+
+      // Returns reference which was kept by the list
+      WorkerPtr Remove(Worker* p)
+      {
+        WorkerHook& h = p->*Hook;
+        if (h.Ref == nullptr)
+          return WorkerPtr();
+
+        if (h.Prev)
+          (h.Prev->*Hook).Next = h.Next;
+        else
+          Head = h.Next;
+
+        if (h.Next)
+          (h.Next->*Hook).Prev = h.Prev;
+        else
+          Tail = h.Prev;
+
+        h.Prev = nullptr;
+        h.Next = nullptr;
+        Count--;
+
+        WorkerPtr t;
+        t.swap(h.Ref);
+        return t;
+      }
+
+      WorkerPtr PopFront()
+      {
+        if (Head == nullptr)
+          return WorkerPtr();
+
+        return Remove(Head);
+      }
+
+      void Clear()
+      {
+        while (Head)
+          Remove(Head);
+      }
+
+    private:
+      WorkerList(const WorkerList&) = delete;
+      WorkerList& operator=(const WorkerList&) = delete;
+    };
+  }
+}
@@ -7,4 +7,7 @@
 namespace Syncme
 {
   SINCMELNK uint64_t GetTimeInMillisec();
+
+  // Monotonic time for measuring of intervals
+  SINCMELNK uint64_t GetTimeInMicrosec();
 }
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+#include <Syncme/Affinity.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <sched.h>
+#include <string>
+#include <unistd.h>
+#else
+#include <thread>
+#endif
+
+using namespace Syncme;
+
+namespace
+{
+  struct Topology
+  {
+    uint32_t Cpus = 1;
+    std::vector<CpuSet> Nodes;
+    std::vector<uint32_t> CpuNode;
+
+    Topology();
+  };
+
+#if defined(__linux__)
+  // Parses lists of CPUs or NUMA nodes like "0-3,8-11"
+  CpuSet ParseCpuList(const std::string& list)
+  {
+    CpuSet cpus;
+
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+      size_t end = list.find(',', pos);
+      if (end == std::string::npos)
+        end = list.size();
+
+      std::string range = list.substr(pos, end - pos);
+      pos = end + 1;
+
+      if (range.empty() || !isdigit((unsigned char)range[0]))
+        continue;
+
+      uint32_t first = (uint32_t)std::stoul(range);
+      uint32_t last = first;
+
+      size_t dash = range.find('-');
+      if (dash != std::string::npos)
+        last = (uint32_t)std::stoul(range.substr(dash + 1));
+
+      for (uint32_t i = first; i <= last; ++i)
+        cpus.push_back(i);
+    }
+
+    return cpus;
+  }
+#endif
+
+  Topology::Topology()
+  {
+#if defined(_WIN32)
+    Cpus = std::max<uint32_t>(1, GetActiveProcessorCount(0));
+
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest))
+    {
+      Nodes.resize(size_t(highest) + 1);
+
+      for (ULONG node = 0; node <= highest; ++node)
+      {
+        ULONGLONG mask = 0;
+        if (!GetNumaNodeProcessorMask(UCHAR(node), &mask))
+          continue;
+
+        for (uint32_t i = 0; i < 64 && i < Cpus; ++i)
+        {
+          if (mask & (1ULL << i))
+            Nodes[node].push_back(i);
+        }
+      }
+    }
+#elif defined(__linux__)
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    Cpus = n > 0 ? uint32_t(n) : 1;
+
+    // Node ids can be sparse. Nodes are indexed by kernel ids, so ids
+    // which are not online and memory-only nodes have no CPUs
+    std::ifstream online("/sys/devices/system/node/online");
+
+    std::string nodes;
+    if (online)
+      std::getline(online, nodes);
+
+    for (uint32_t node : ParseCpuList(nodes))
+    {
+      std::ifstream file(
+        "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"
+      );
+
+      std::string list;
+      if (file)
+        std::getline(file, list);
+
+      if (node >= Nodes.size())
+        Nodes.resize(size_t(node) + 1);
+
+      Nodes[node] = ParseCpuList(list);
+    }
+#else
+    Cpus = std::max<uint32_t>(1, std::thread::hardware_concurrency());
+#endif
+
+    bool hasCpus = std::any_of(
+      Nodes.begin()
+      , Nodes.end()
+      , [](const CpuSet& cpus) { return !cpus.empty(); }
+    );
+
+    if (!hasCpus)
+    {
+      Nodes.clear();
+
+      CpuSet cpus;
+      for (uint32_t i = 0; i < Cpus; ++i)
+        cpus.push_back(i);
+
+      Nodes.push_back(cpus);
+    }
+
+    CpuNode.resize(Cpus, 0);
+    for (uint32_t node = 0; node < Nodes.size(); ++node)
+    {
+      for (uint32_t cpu : Nodes[node])
+      {
+        if (cpu >= CpuNode.size())
+          CpuNode.resize(cpu + 1, 0);
+
+        CpuNode[cpu] = node;
+      }
+    }
+  }
+
+  const Topology& GetTopology()
+  {
+    static Topology topology;
+    return topology;
+  }
+
+  std::mutex RuntimeLock;
+  CpuSet RuntimeAffinity;
+}
+
+uint32_t Syncme::GetCpuCount()
+{
+  return GetTopology().Cpus;
+}
+
+uint32_t Syncme::GetCurrentCpu()
+{
+#if defined(_WIN32)
+  return ::GetCurrentProcessorNumber();
+#elif defined(__linux__)
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : uint32_t(cpu);
+#else
+  return 0;
+#endif
+}
+
+uint32_t Syncme::GetNumaNodeCount()
+{
+  return uint32_t(GetTopology().Nodes.size());
+}
+
+CpuSet Syncme::GetNumaNodeCpus(uint32_t node)
+{
+  auto& topology = GetTopology();
+  if (node >= topology.Nodes.size())
+    return CpuSet();
+
+  return topology.Nodes[node];
+}
+
+uint32_t Syncme::GetNumaNodeOfCpu(uint32_t cpu)
+{
+  auto& topology = GetTopology();
+  if (cpu >= topology.CpuNode.size())
+    return 0;
+
+  return topology.CpuNode[cpu];
+}
+
+uint32_t Syncme::GetCurrentNumaNode()
+{
+  return GetNumaNodeOfCpu(GetCurrentCpu());
+}
+
+CpuSet Syncme::GetCurrentThreadAffinity()
+{
+  CpuSet cpus;
+
+#if defined(_WIN32)
+  // There is no GetThreadAffinityMask(). Set the process mask to learn
+  // the current one and restore it
+  DWORD_PTR process{}, system{};
+  if (GetProcessAffinityMask(GetCurrentProcess(), &process, &system))
+  {
+    DWORD_PTR mask = SetThreadAffinityMask(GetCurrentThread(), process);
+    if (mask)
+      SetThreadAffinityMask(GetCurrentThread(), mask);
+    else
+      mask = process;
+
+    for (uint32_t i = 0; i < sizeof(mask) * 8; ++i)
+    {
+      if (mask & (DWORD_PTR(1) << i))
+        cpus.push_back(i);
+    }
+  }
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+  {
+    for (uint32_t i = 0; i < CPU_SETSIZE; ++i)
+    {
+      if (CPU_ISSET(i, &set))
+        cpus.push_back(i);
+    }
+  }
+#endif
+
+  return cpus;
+}
+
+bool Syncme::SetCurrentThreadAffinity(const CpuSet& cpus)
+{
+  if (cpus.empty())
+    return false;
+
+#if defined(_WIN32)
+  DWORD_PTR mask = 0;
+  for (uint32_t cpu : cpus)
+  {
+    if (cpu < sizeof(mask) * 8)
+      mask |= DWORD_PTR(1) << cpu;
+  }
+
+  return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  for (uint32_t cpu : cpus)
+  {
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  }
+
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+void Syncme::SetRuntimeAffinity(const CpuSet& cpus)
+{
+  std::lock_guard guard(RuntimeLock);
+  RuntimeAffinity = cpus;
+}
+
+CpuSet Syncme::GetRuntimeAffinity()
+{
+  std::lock_guard guard(RuntimeLock);
+  return RuntimeAffinity;
+}
+
+void Syncme::ApplyRuntimeAffinity()
+{
+  CpuSet cpus = GetRuntimeAffinity();
+  if (!cpus.empty())
+    SetCurrentThreadAffinity(cpus);
+}
@@ -0,0 +1,101 @@
+#include <Syncme/Futex.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Unexpected atomic layout");
+
+using namespace Syncme;
+
+#if defined(_WIN32)
+
+bool Syncme::FutexWait(std::atomic<uint32_t>& word, uint32_t expected, uint32_t ms)
+{
+  DWORD timeout = ms == FOREVER ? INFINITE : DWORD(ms);
+
+  if (WaitOnAddress(&word, &expected, sizeof(expected), timeout))
+    return true;
+
+  return ::GetLastError() != ERROR_TIMEOUT;
+}
+
+void Syncme::FutexWakeOne(std::atomic<uint32_t>& word)
+{
+  WakeByAddressSingle(&word);
+}
+
+void Syncme::FutexWakeAll(std::atomic<uint32_t>& word)
+{
+  WakeByAddressAll(&word);
+}
+
+#elif defined(__linux__)
+
+bool Syncme::FutexWait(std::atomic<uint32_t>& word, uint32_t expected, uint32_t ms)
+{
+  timespec ts{};
+  timespec* pts = nullptr;
+
+  if (ms != FOREVER)
+  {
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = long(ms % 1000) * 1000000L;
+    pts = &ts;
+  }
+
+  long rc = syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0);
+  if (rc == 0)
+    return true;
+
+  return errno != ETIMEDOUT;
+}
+
+void Syncme::FutexWakeOne(std::atomic<uint32_t>& word)
+{
+  syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void Syncme::FutexWakeAll(std::atomic<uint32_t>& word)
+{
+  syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+// Portable fallback. Polls the word with short sleeps
+bool Syncme::FutexWait(std::atomic<uint32_t>& word, uint32_t expected, uint32_t ms)
+{
+  using namespace std::chrono;
+  auto t0 = steady_clock::now();
+
+  while (word.load(std::memory_order_acquire) == expected)
+  {
+    if (ms != FOREVER && steady_clock::now() - t0 >= milliseconds(ms))
+      return false;
+
+    std::this_thread::sleep_for(microseconds(100));
+  }
+
+  return true;
+}
+
+void Syncme::FutexWakeOne(std::atomic<uint32_t>&)
+{
+}
+
+void Syncme::FutexWakeAll(std::atomic<uint32_t>&)
+{
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <Syncme/Histogram.h>
+
+using namespace Syncme;
+
+Histogram::Histogram()
+  : Buckets{}
+  , Sum(0)
+  , Min(std::numeric_limits<uint64_t>::max())
+  , Max(0)
+{
+}
+
+size_t Histogram::GetBucket(uint64_t value)
+{
+  if (value < SUB_COUNT)
+    return size_t(value);
+
+  unsigned msb = 63 - unsigned(std::countl_zero(value));
+  unsigned shift = msb - SUB_BITS;
+
+  // (value >> shift) is in range [SUB_COUNT, 2 * SUB_COUNT)
+  return SUB_COUNT * (shift + 1) + size_t(value >> shift) - SUB_COUNT;
+}
+
+uint64_t Histogram::GetBucketLimit(size_t bucket)
+{
+  assert(bucket < BUCKETS);
+
+  if (bucket < SUB_COUNT)
+    return bucket;
+
+  unsigned shift = unsigned(bucket / SUB_COUNT) - 1;
+  uint64_t sub = SUB_COUNT + bucket % SUB_COUNT;
+
+  return (sub << shift) + ((uint64_t(1) << shift) - 1);
+}
+
+void Histogram::Record(uint64_t value)
+{
+  Buckets[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+  Sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t min = Min.load(std::memory_order_relaxed);
+  while (value < min && !Min.compare_exchange_weak(min, value, std::memory_order_relaxed));
+
+  uint64_t max = Max.load(std::memory_order_relaxed);
+  while (value > max && !Max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+HistogramSnapshot Histogram::Snapshot() const
+{
+  HistogramSnapshot s{};
+  s.Buckets.resize(BUCKETS);
+
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    s.Buckets[i] = Buckets[i].load(std::memory_order_relaxed);
+    s.Count += s.Buckets[i];
+  }
+
+  s.Sum = Sum.load(std::memory_order_relaxed);
+  s.Min = s.Count ? Min.load(std::memory_order_relaxed) : 0;
+  s.Max = Max.load(std::memory_order_relaxed);
+  return s;
+}
+
+HistogramSnapshot Histogram::SnapshotAndReset()
+{
+  HistogramSnapshot s{};
+  s.Buckets.resize(BUCKETS);
+
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    s.Buckets[i] = Buckets[i].exchange(0, std::memory_order_relaxed);
+    s.Count += s.Buckets[i];
+  }
+
+  s.Sum = Sum.exchange(0, std::memory_order_relaxed);
+  s.Min = Min.exchange(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  s.Max = Max.exchange(0, std::memory_order_relaxed);
+
+  if (s.Count == 0)
+    s.Min = 0;
+
+  return s;
+}
+
+void Histogram::Reset()
+{
+  SnapshotAndReset();
+}
+
+uint64_t HistogramSnapshot::Percentile(double p) const
+{
+  if (Count == 0)
+    return 0;
+
+  if (p <= 0)
+    return Min;
+
+  if (p >= 100)
+    return Max;
+
+  uint64_t rank = uint64_t(std::ceil(p / 100.0 * double(Count)));
+  if (rank == 0)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < Buckets.size(); ++i)
+  {
+    seen += Buckets[i];
+
+    if (seen >= rank)
+      return std::min(Histogram::GetBucketLimit(i), Max);
+  }
+
+  return Max;
+}
+
+double HistogramSnapshot::Mean() const
+{
+  return Count ? double(Sum) / double(Count) : 0.0;
+}
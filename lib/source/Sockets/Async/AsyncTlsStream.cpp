@@ -8,6 +8,7 @@
 
 #include <Syncme/Logger/Log.h>
 #include <Syncme/Sockets/Async/AsyncTlsStream.h>
+#include <Syncme/Sockets/BufferPool.h>
 #include <Syncme/Sockets/SSLHelpers.h>
 #include <Syncme/Sockets/Socket.h>
 
@@ -364,7 +365,7 @@ bool AsyncTlsStream::AdoptPlaintextPending()
     if (SSL_has_pending(Ssl) == 0 && SSL_pending(Ssl) <= 0)
       return true;
 
-    auto buffer = std::make_shared<IO::Buffer>();
+    IO::BufferPtr buffer = IO::AllocateBuffer(ENCRYPTED_READ_SIZE);
     if (buffer == nullptr)
       return false;
 
@@ -424,6 +425,8 @@ bool AsyncTlsStream::DeliverAdoptedPlaintext()
   {
     AdoptedPlainBuffers.pop_front();
     AdoptedPlainOffset = 0;
+
+    IO::FreeBuffer(source);
   }
 
   IO::BufferPtr buffer = PlainReadBuffer;
@@ -643,7 +646,7 @@ bool AsyncTlsStream::DrainEncryptedOutput()
       return true;
 
     size_t size = std::min(pending, ENCRYPTED_CHUNK_SIZE);
-    IO::BufferPtr buffer = std::make_shared<IO::Buffer>();
+    IO::BufferPtr buffer = IO::AllocateBuffer(size);
     if (buffer == nullptr)
       return false;
 
@@ -676,7 +679,7 @@ bool AsyncTlsStream::StartLowerRead()
   if (!PlainReadPending && HandshakeCompleted && !ShutdownPending)
     return true;
 
-  IO::BufferPtr buffer = std::make_shared<IO::Buffer>();
+  IO::BufferPtr buffer = IO::AllocateBuffer(ENCRYPTED_READ_SIZE);
   if (buffer == nullptr)
     return false;
 
@@ -49,6 +49,7 @@ bool AsyncWriteQueue::OnWriteCompleted(size_t bytes)
   if (bytes != size)
     return false;
 
+  Queue.front().Clear();
   Queue.pop_front();
   QueuedBytes -= size;
   WritePending = false;
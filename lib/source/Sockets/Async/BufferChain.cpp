@@ -1,6 +1,9 @@
+#include <algorithm>
+#include <string.h>
 #include <utility>
 
 #include <Syncme/Sockets/Async/BufferChain.h>
+#include <Syncme/Sockets/BufferPool.h>
 
 using namespace Syncme::Sockets::Async;
 
@@ -34,8 +37,38 @@ bool BufferChain::Add(Syncme::Sockets::IO::BufferPtr buffer)
   return Add(buffer, 0, buffer->size());
 }
 
+bool BufferChain::Append(const void* data, size_t size)
+{
+  if (data == nullptr || size == 0)
+    return false;
+
+  const char* p = (const char*)data;
+  while (size)
+  {
+    size_t n = std::min(size, Syncme::Sockets::IO::BUFFER_SIZE);
+
+    auto buffer = Syncme::Sockets::IO::AllocateBuffer(n);
+    buffer->resize(n);
+    memcpy(buffer->data(), p, n);
+
+    Views.emplace_back(std::move(buffer), 0, n);
+    TotalSize += n;
+
+    p += n;
+    size -= n;
+  }
+
+  return true;
+}
+
 void BufferChain::Clear()
 {
+  for (auto& view : Views)
+  {
+    if (view.Buffer.use_count() == 1)
+      Syncme::Sockets::IO::FreeBuffer(std::move(view.Buffer));
+  }
+
   Views.clear();
   TotalSize = 0;
 }
@@ -54,3 +87,16 @@ const std::vector<BufferView>& BufferChain::GetViews() const
 {
   return Views;
 }
+
+size_t BufferChain::GetSpans(Syncme::Sockets::IO::Span* spans, size_t count) const
+{
+  size_t n = std::min(count, Views.size());
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    spans[i].Data = Views[i].Buffer->data() + Views[i].Offset;
+    spans[i].Size = Views[i].Size;
+  }
+
+  return n;
+}
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <cassert>
+#include <limits.h>
+#include <vector>
 
 #include <Syncme/Logger/Log.h>
 #include <Syncme/Sockets/API.h>
@@ -7,6 +10,10 @@
 #include <Syncme/Sockets/SocketPair.h>
 #include <Syncme/TickCount.h>
 
+#ifndef _WIN32
+#include <sys/sendfile.h>
+#endif
+
 using namespace Syncme;
 
 BIOSocket::BIOSocket(SocketPair* pair)
@@ -118,6 +125,124 @@ int BIOSocket::InternalWrite(const void* buffer, size_t size, int timeout)
   return n;
 }
 
+int BIOSocket::InternalWriteV(const Sockets::IO::Span* spans, size_t count)
+{
+  if (count == 1)
+    return InternalWrite(spans[0].Data, spans[0].Size, 0);
+
+  std::lock_guard<std::mutex> guard(BioLock);
+
+  // Data is passed to the kernel by one call instead of one BIO_write()
+  // per queued buffer. BIO has no vectored write, so the socket is used
+  // directly
+#ifdef _WIN32
+  static thread_local std::vector<WSABUF> iov;
+  iov.resize(count);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    iov[i].buf = (char*)spans[i].Data;
+    iov[i].len = ULONG(spans[i].Size);
+  }
+
+  DWORD sent = 0;
+  if (WSASend((SOCKET)Handle, iov.data(), DWORD(count), &sent, 0, nullptr, nullptr) == 0)
+    return int(sent);
+
+  int e = WSAGetLastError();
+  if (e == WSAEWOULDBLOCK || e == WSAEINTR)
+  {
+    SKT_SET_LAST_ERROR(WOULDBLOCK);
+    return 0;
+  }
+#else
+  static thread_local std::vector<iovec> iov;
+  iov.resize(count);
+
+  // Result is returned as int
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (i && total + spans[i].Size > INT_MAX)
+    {
+      count = i;
+      break;
+    }
+
+    iov[i].iov_base = (void*)spans[i].Data;
+    iov[i].iov_len = spans[i].Size;
+    total += spans[i].Size;
+  }
+
+  msghdr msg{};
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = count;
+
+  ssize_t n = sendmsg(Handle, &msg, MSG_NOSIGNAL);
+  if (n >= 0)
+    return int(n);
+
+  if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+  {
+    SKT_SET_LAST_ERROR(WOULDBLOCK);
+    return 0;
+  }
+#endif
+
+  SKT_SET_LAST_ERROR(IO_INCOMPLETE);
+  CloseNotify = false;
+  return -1;
+}
+
+int BIOSocket::InternalSendFile(PendingFile& file)
+{
+#ifdef _WIN32
+  return Socket::InternalSendFile(file);
+#else
+  if (true)
+  {
+    std::lock_guard<std::mutex> guard(BioLock);
+
+    // File data is copied to the socket by the kernel
+    off_t offset = off_t(file.Offset);
+    size_t size = size_t(std::min<uint64_t>(file.Left, 1ULL << 30));
+
+    ssize_t n = sendfile(Handle, file.Fd, &offset, size);
+    if (n > 0)
+      return int(n);
+
+    if (n == 0)
+    {
+      LogE("file is shorter than requested");
+      SKT_SET_LAST_ERROR(IO_INCOMPLETE);
+      CloseNotify = false;
+      return -1;
+    }
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+    {
+      SKT_SET_LAST_ERROR(WOULDBLOCK);
+      return 0;
+    }
+
+    if (errno != EINVAL && errno != ENOSYS)
+    {
+      SKT_SET_LAST_ERROR(IO_INCOMPLETE);
+      CloseNotify = false;
+      return -1;
+    }
+  }
+
+  // The file can not be used by sendfile()
+  return Socket::InternalSendFile(file);
+#endif
+}
+
+size_t BIOSocket::GetObjectSize() const
+{
+  return sizeof(BIOSocket);
+}
+
 int BIOSocket::GetFD() const
 {
   int socket = 0;
@@ -0,0 +1,203 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <Syncme/Sockets/BufferPool.h>
+#include <Syncme/Uninitialize.h>
+
+using namespace Syncme;
+using namespace Syncme::Implementation;
+using namespace Syncme::Sockets::IO;
+
+namespace
+{
+  constexpr static size_t CLASSES = 4;
+  constexpr static size_t ClassSize[CLASSES] = {
+    4ULL * 1024
+    , 16ULL * 1024
+    , 64ULL * 1024
+    , BUFFER_SIZE
+  };
+
+  struct Depot
+  {
+    std::mutex Lock[CLASSES];
+    std::vector<BufferPtr> Buffers[CLASSES];
+  };
+
+  struct Magazine
+  {
+    std::vector<BufferPtr> Buffers[CLASSES];
+
+    ~Magazine();
+  };
+
+  ON_SYNCME_UNINITIALIZE(&Syncme::Sockets::IO::TrimBufferPool)
+}
+
+static std::atomic<uint64_t> Requests;
+static std::atomic<uint64_t> Hits;
+static std::atomic<size_t> Held;
+static std::atomic<size_t> Limit(POOL_LIMIT);
+
+static thread_local Magazine Local;
+
+// Depot is not deleted by static destructors: threads can exit after them
+static Depot& GetDepot()
+{
+  static Depot* depot = new Depot();
+  return *depot;
+}
+
+// Smallest class which fits size
+static size_t ClassForSize(size_t size)
+{
+  for (size_t i = 0; i < CLASSES; ++i)
+  {
+    if (size <= ClassSize[i])
+      return i;
+  }
+
+  return CLASSES;
+}
+
+// Largest class which fits in capacity
+static size_t ClassForCapacity(size_t capacity)
+{
+  if (capacity > BUFFER_SIZE)
+    return CLASSES;
+
+  for (size_t i = CLASSES; i > 0; --i)
+  {
+    if (capacity >= ClassSize[i - 1])
+      return i - 1;
+  }
+
+  return CLASSES;
+}
+
+static bool Reserve(size_t capacity)
+{
+  size_t held = Held.load(std::memory_order_relaxed);
+
+  for (;;)
+  {
+    if (held + capacity > Limit.load(std::memory_order_relaxed))
+      return false;
+
+    if (Held.compare_exchange_weak(held, held + capacity, std::memory_order_relaxed))
+      return true;
+  }
+}
+
+static void MoveToDepot(std::vector<BufferPtr>& from, size_t c, size_t count)
+{
+  Depot& depot = GetDepot();
+  std::lock_guard guard(depot.Lock[c]);
+
+  for (; count && from.empty() == false; --count)
+  {
+    depot.Buffers[c].push_back(std::move(from.back()));
+    from.pop_back();
+  }
+}
+
+Magazine::~Magazine()
+{
+  for (size_t c = 0; c < CLASSES; ++c)
+    MoveToDepot(Buffers[c], c, Buffers[c].size());
+}
+
+BufferPtr Syncme::Sockets::IO::AllocateBuffer(size_t size)
+{
+  Requests.fetch_add(1, std::memory_order_relaxed);
+
+  size_t c = ClassForSize(size);
+  if (c == CLASSES)
+  {
+    BufferPtr b = std::make_shared<Buffer>();
+    b->reserve(size);
+    return b;
+  }
+
+  auto& magazine = Local.Buffers[c];
+  if (magazine.empty())
+  {
+    Depot& depot = GetDepot();
+    std::lock_guard guard(depot.Lock[c]);
+
+    auto& buffers = depot.Buffers[c];
+    for (size_t n = MAGAZINE_SIZE / 2; n && buffers.empty() == false; --n)
+    {
+      magazine.push_back(std::move(buffers.back()));
+      buffers.pop_back();
+    }
+  }
+
+  if (magazine.empty())
+  {
+    BufferPtr b = std::make_shared<Buffer>();
+    b->reserve(ClassSize[c]);
+    return b;
+  }
+
+  BufferPtr b = std::move(magazine.back());
+  magazine.pop_back();
+
+  Held -= b->capacity();
+  Hits.fetch_add(1, std::memory_order_relaxed);
+  return b;
+}
+
+void Syncme::Sockets::IO::FreeBuffer(BufferPtr b)
+{
+  if (b == nullptr)
+    return;
+
+  size_t c = ClassForCapacity(b->capacity());
+  if (c == CLASSES || Reserve(b->capacity()) == false)
+    return;
+
+  auto& magazine = Local.Buffers[c];
+  if (magazine.size() >= MAGAZINE_SIZE)
+    MoveToDepot(magazine, c, MAGAZINE_SIZE / 2);
+
+  magazine.push_back(std::move(b));
+}
+
+void Syncme::Sockets::IO::SetBufferPoolLimit(size_t limit)
+{
+  Limit = limit;
+
+  if (Held > limit)
+    TrimBufferPool();
+}
+
+BufferPoolStats Syncme::Sockets::IO::GetBufferPoolStats()
+{
+  BufferPoolStats stats{};
+  stats.Requests = Requests;
+  stats.Hits = Hits;
+  stats.Held = Held;
+  stats.Limit = Limit;
+  return stats;
+}
+
+void Syncme::Sockets::IO::TrimBufferPool()
+{
+  Depot& depot = GetDepot();
+
+  for (size_t c = 0; c < CLASSES; ++c)
+  {
+    std::vector<BufferPtr> buffers;
+
+    if (true)
+    {
+      std::lock_guard guard(depot.Lock[c]);
+      buffers.swap(depot.Buffers[c]);
+    }
+
+    for (auto& b : buffers)
+      Held -= b->capacity();
+  }
+}
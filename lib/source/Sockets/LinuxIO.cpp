@@ -13,6 +13,12 @@ using namespace Syncme;
 
 void Socket::EventSignalled(WAIT_RESULT r, uint32_t cookie, bool failed)
 {
+  if (SharedReactor)
+  {
+    Waiter.Signal(Implementation::REACTOR_WAKE);
+    return;
+  }
+
   // write() will force epoll_wait to exit
   // we have to write a value > 0
   uint64_t value = uint64_t(r) + 1;
@@ -62,7 +68,12 @@ bool Socket::UpdateEpollEventList()
   if (EpollMask == ev.events)
     return true;
 
-  if (epoll_ctl(Poll, EPOLL_CTL_MOD, Handle, &ev) == -1)
+  if (SharedReactor)
+  {
+    if (Implementation::Reactor::Update(Handle, &Waiter, ev.events) == false)
+      return false;
+  }
+  else if (epoll_ctl(Poll, EPOLL_CTL_MOD, Handle, &ev) == -1)
   {
     LogosE("epoll: epoll_ctl(EPOLL_CTL_MOD) failed for Handle");
     return false;
@@ -82,6 +93,9 @@ WAIT_RESULT Socket::FastWaitForMultipleObjects(int timeout, IOStat& stat)
   if (UpdateEpollEventList() == false)
     return WAIT_RESULT::FAILED;
 
+  if (SharedReactor)
+    return SharedReactorWait(timeout);
+
   int n = 0;
   epoll_event events[2]{};
 
@@ -142,6 +156,28 @@ WAIT_RESULT Socket::FastWaitForMultipleObjects(int timeout, IOStat& stat)
   return result;
 }
 
+// Wait time is counted by IO()
+WAIT_RESULT Socket::SharedReactorWait(int timeout)
+{
+  // Readiness is edge triggered. IO() reads and writes till EAGAIN
+  // before it waits, so a stale bit costs one extra cycle only
+  uint32_t bits = Waiter.Take(uint32_t(timeout));
+  if (bits == 0)
+    return WAIT_RESULT::TIMEOUT;
+
+  // Bits of the socket are kept till IO() processes OBJECT_2
+  EventsMask |= int(bits & (EVENT_READ | EVENT_WRITE | EVENT_CLOSE));
+
+  if (bits & Implementation::REACTOR_WAKE)
+  {
+    WAIT_RESULT result = EventStateToWaitResult();
+    if (result != WAIT_RESULT::FAILED)
+      return result;
+  }
+
+  return WAIT_RESULT::OBJECT_2;
+}
+
 bool Socket::IO(int timeout, IOStat& stat, IOFlags flags)
 {
   std::lock_guard<std::mutex> guard(IOLock);
@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <cassert>
 #include <string.h>
 
+#include <Syncme/Sockets/Async/BufferChain.h>
+#include <Syncme/Sockets/BufferPool.h>
 #include <Syncme/Sockets/Queue.h>
 
 #ifdef _WIN32
@@ -10,19 +13,60 @@
 using namespace Syncme;
 using namespace Syncme::Sockets::IO;
 
+static size_t BufferMemory(const BufferPtr& b)
+{
+  return sizeof(Buffer) + b->capacity();
+}
+
+BufferPtr Syncme::Sockets::IO::GetScratchBuffer()
+{
+  return AllocateBuffer(BUFFER_SIZE);
+}
+
+void Syncme::Sockets::IO::ReleaseScratchBuffer(BufferPtr b)
+{
+  FreeBuffer(b);
+}
+
+size_t Syncme::Sockets::IO::GetScratchMemory()
+{
+  return GetBufferPoolStats().Held;
+}
+
 Queue::Queue(size_t limit, TSignalTxReady signal)
   : Limit(limit)
   , Signal(signal)
   , Total(0)
+  , Offset(0)
+  , External(0)
   , AutoJoin(false)
 {
 }
 
+Queue::~Queue()
+{
+  for (auto& b : Free)
+    FreeBuffer(b);
+}
+
 void Queue::SetAutoJoin(bool f)
 {
   AutoJoin = f;
 }
 
+void Queue::GetMemoryUsage(size_t& queued, size_t& cached) const
+{
+  std::lock_guard guard(Lock);
+
+  queued = 0;
+  for (auto& b : Packets)
+    queued += BufferMemory(b);
+
+  cached = 0;
+  for (auto& b : Free)
+    cached += BufferMemory(b);
+}
+
 void Queue::SetSignallReady(TSignalTxReady signal)
 {
   Signal = signal;
@@ -74,8 +118,11 @@ void Queue::PushFree(BufferPtr b)
       std::lock_guard guard(Lock);
 
       Free.push_back(b);
+      return;
     }
   }
+
+  FreeBuffer(b);
 }
 
 BufferPtr Queue::GetBuffer(Queue* borrowFrom)
@@ -88,13 +135,7 @@ BufferPtr Queue::GetBuffer(Queue* borrowFrom)
       b = borrowFrom->PopFree();
 
     if (b == nullptr)
-    {
-      b = std::make_shared<Buffer>();
-      if (b == nullptr)
-        return BufferPtr();
-
-      b->reserve(BUFFER_SIZE);
-    }
+      b = AllocateBuffer(BUFFER_SIZE);
   }
 
   return b;
@@ -180,6 +221,7 @@ bool Queue::Insert(const void* p, size_t cb, size_t* qsize, Queue* borrowFrom)
 
     std::lock_guard guard(Lock);
 
+    Locked_DropOffset();
     Packets.push_front(b);
     Total += cb;
 
@@ -258,16 +300,43 @@ bool Queue::IsEmpty() const
 {
   std::lock_guard guard(Lock);
 
-  return Total == 0;
+  return Total == 0 && External == 0;
 }
 
 size_t Queue::Size() const
 {
   std::lock_guard guard(Lock);
 
+  return Total + External;
+}
+
+size_t Queue::BufferedSize() const
+{
+  std::lock_guard guard(Lock);
+
   return Total;
 }
 
+void Queue::AddExternal(size_t n)
+{
+  if (true)
+  {
+    std::lock_guard guard(Lock);
+    External += n;
+  }
+
+  if (Signal)
+    Signal();
+}
+
+void Queue::RemoveExternal(size_t n)
+{
+  std::lock_guard guard(Lock);
+
+  assert(n <= External);
+  External -= n;
+}
+
 size_t Queue::Count() const
 {
   std::lock_guard guard(Lock);
@@ -285,6 +354,8 @@ BufferPtr Queue::Join(size_t upto)
   if (upto != -1 && Total > upto)
     return PopFirst();
 
+  Locked_DropOffset();
+
   BufferPtr b = Packets.front();    
   size_t pos = b->size();
   b->resize(Total);
@@ -313,6 +384,7 @@ void Queue::PushFront(BufferPtr b, bool signal)
   {
     std::lock_guard guard(Lock);
 
+    Locked_DropOffset();
     Packets.push_front(b);
     Total += b->size();
   }
@@ -321,6 +393,115 @@ void Queue::PushFront(BufferPtr b, bool signal)
     Signal();
 }
 
+void Queue::Locked_DropOffset()
+{
+  if (Offset == 0)
+    return;
+
+  auto& b = Packets.front();
+
+  // Consumed part can be referenced by a BufferChain
+  if (b.use_count() > 1)
+  {
+    BufferPtr copy = GetBuffer();
+    copy->assign(b->begin() + Offset, b->end());
+    b = copy;
+  }
+  else
+    b->erase(b->begin(), b->begin() + Offset);
+
+  Offset = 0;
+}
+
+size_t Queue::GetSpans(Span* spans, size_t count) const
+{
+  std::lock_guard guard(Lock);
+
+  size_t n = 0;
+  size_t offset = Offset;
+
+  for (auto it = Packets.begin(); it != Packets.end() && n < count; ++it)
+  {
+    const BufferPtr& b = *it;
+
+    if (b->size() > offset)
+    {
+      spans[n].Data = b->data() + offset;
+      spans[n].Size = b->size() - offset;
+      n++;
+    }
+
+    offset = 0;
+  }
+
+  return n;
+}
+
+void Queue::Consume(size_t n)
+{
+  BufferList done;
+
+  if (true)
+  {
+    std::lock_guard guard(Lock);
+
+    assert(n <= Total);
+    Total -= n;
+
+    while (Packets.empty() == false)
+    {
+      BufferPtr& b = Packets.front();
+
+      size_t left = b->size() - Offset;
+      if (n < left)
+      {
+        Offset += n;
+        break;
+      }
+
+      n -= left;
+      Offset = 0;
+
+      done.push_back(b);
+      Packets.pop_front();
+    }
+  }
+
+  for (auto& b : done)
+    FreeBuffer(b);
+}
+
+size_t Queue::MoveTo(Async::BufferChain& chain, size_t upto)
+{
+  std::lock_guard guard(Lock);
+
+  size_t moved = 0;
+  while (moved < upto && Packets.empty() == false)
+  {
+    BufferPtr& b = Packets.front();
+
+    size_t left = b->size() - Offset;
+    size_t n = std::min(left, upto - moved);
+
+    if (n)
+      chain.Add(b, Offset, n);
+
+    moved += n;
+    Total -= n;
+
+    if (n < left)
+    {
+      Offset += n;
+      break;
+    }
+
+    Offset = 0;
+    Packets.pop_front();
+  }
+
+  return moved;
+}
+
 BufferPtr Queue::PopFirst()
 {
   std::lock_guard guard(Lock);
@@ -331,6 +512,8 @@ BufferPtr Queue::PopFirst()
     return BufferPtr();
   }
 
+  Locked_DropOffset();
+
   BufferPtr b = Packets.front();
   Packets.pop_front();
 
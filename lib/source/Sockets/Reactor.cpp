@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <errno.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Syncme/Futex.h>
+#include <Syncme/Logger/Log.h>
+#include <Syncme/SetThreadName.h>
+#include <Syncme/Sockets/Reactor.h>
+#include <Syncme/TickCount.h>
+#include <Syncme/Uninitialize.h>
+
+using namespace Syncme;
+using namespace Syncme::Implementation;
+
+// Set by Take() before the owner parks on the word
+constexpr static uint32_t WAITER_PARKED = 0x80000000;
+
+ReactorWaiter::ReactorWaiter()
+  : Ready(0)
+  , Id(0)
+  , Shard(0)
+{
+}
+
+void ReactorWaiter::Signal(uint32_t bits)
+{
+  if (Ready.fetch_or(bits) & WAITER_PARKED)
+    FutexWakeOne(Ready);
+}
+
+uint32_t ReactorWaiter::Take(uint32_t ms)
+{
+  uint64_t start = GetTimeInMillisec();
+
+  for (;;)
+  {
+    uint32_t bits = Ready.exchange(0) & ~WAITER_PARKED;
+    if (bits)
+      return bits;
+
+    uint32_t left = FOREVER;
+    if (ms != FOREVER)
+    {
+      uint64_t elapsed = GetTimeInMillisec() - start;
+      if (elapsed >= ms)
+        return 0;
+
+      left = uint32_t(ms - elapsed);
+    }
+
+    // Signal() wakes us only if it sees the flag
+    uint32_t expected = 0;
+    if (Ready.compare_exchange_strong(expected, WAITER_PARKED))
+      FutexWait(Ready, WAITER_PARKED, left);
+  }
+}
+
+#ifndef _WIN32
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+  // Maximal number of dispatcher threads
+  constexpr static size_t REACTOR_THREADS = 4;
+
+  constexpr static int REACTOR_EVENTS = 256;
+
+  // epoll_event::data of StopEvent. Ids of waiters start from 1
+  constexpr static uint64_t STOP_ID = 0;
+
+  struct Shard
+  {
+    int Poll;
+    int StopEvent;
+    std::thread Thread;
+
+    // Protects Waiters and is held while the thread signals them
+    std::mutex Lock;
+    std::unordered_map<uint64_t, ReactorWaiter*> Waiters;
+
+    Shard()
+      : Poll(-1)
+      , StopEvent(-1)
+    {
+    }
+  };
+
+  ON_SYNCME_UNINITIALIZE(&Syncme::Implementation::Reactor::Uninitialize)
+}
+
+// Shards are not deleted by static destructors: threads are stopped by
+// Uninitialize() only
+static std::mutex DataLock;
+static std::vector<Shard*> Shards;
+static std::atomic<uint64_t> NextId(STOP_ID + 1);
+
+static void DispatchProc(Shard* shard)
+{
+  SET_CUR_THREAD_NAME("Reactor");
+
+  std::vector<epoll_event> events(REACTOR_EVENTS);
+
+  for (;;)
+  {
+    int n = epoll_wait(shard->Poll, events.data(), int(events.size()), -1);
+    if (n < 0 && errno == EINTR)
+      continue;
+
+    if (n < 0)
+    {
+      LogosE("epoll_wait failed");
+      return;
+    }
+
+    std::lock_guard guard(shard->Lock);
+
+    for (int i = 0; i < n; ++i)
+    {
+      epoll_event& e = events[i];
+      if (e.data.u64 == STOP_ID)
+        return;
+
+      auto it = shard->Waiters.find(e.data.u64);
+      if (it == shard->Waiters.end())
+        continue;
+
+      uint32_t bits = 0;
+
+      // Errors are reported by the next read
+      if (e.events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        bits |= EVENT_READ;
+
+      if (e.events & EPOLLOUT)
+        bits |= EVENT_WRITE;
+
+      if (e.events & EPOLLRDHUP)
+        bits |= EVENT_CLOSE;
+
+      it->second->Signal(bits);
+    }
+  }
+}
+
+static void FreeShard(Shard* shard)
+{
+  if (shard->Thread.joinable())
+  {
+    uint64_t value = 1;
+    if (write(shard->StopEvent, &value, sizeof(value)) != sizeof(value))
+    {
+      LogosE("write(StopEvent) failed");
+    }
+
+    shard->Thread.join();
+  }
+
+  if (shard->StopEvent != -1)
+    close(shard->StopEvent);
+
+  if (shard->Poll != -1)
+    close(shard->Poll);
+
+  delete shard;
+}
+
+static Shard* CreateShard()
+{
+  Shard* shard = new Shard();
+
+  shard->Poll = epoll_create(1);
+  if (shard->Poll == -1)
+  {
+    LogosE("epoll_create failed");
+    FreeShard(shard);
+    return nullptr;
+  }
+
+  shard->StopEvent = eventfd(0, EFD_NONBLOCK);
+  if (shard->StopEvent == -1)
+  {
+    LogosE("eventfd failed");
+    FreeShard(shard);
+    return nullptr;
+  }
+
+  epoll_event ev{};
+  ev.data.u64 = STOP_ID;
+  ev.events = EPOLLIN;
+
+  if (epoll_ctl(shard->Poll, EPOLL_CTL_ADD, shard->StopEvent, &ev) == -1)
+  {
+    LogosE("epoll_ctl(EPOLL_CTL_ADD) failed for StopEvent");
+    FreeShard(shard);
+    return nullptr;
+  }
+
+  shard->Thread = std::thread(&DispatchProc, shard);
+  return shard;
+}
+
+static Shard* GetShard(size_t index, bool create)
+{
+  std::lock_guard guard(DataLock);
+
+  if (Shards.empty() && create)
+  {
+    size_t n = std::clamp(size_t(std::thread::hardware_concurrency()), size_t(1), REACTOR_THREADS);
+    for (size_t i = 0; i < n; ++i)
+    {
+      Shard* shard = CreateShard();
+      if (shard == nullptr)
+        break;
+
+      Shards.push_back(shard);
+    }
+  }
+
+  if (Shards.empty())
+    return nullptr;
+
+  return Shards[index % Shards.size()];
+}
+
+bool Syncme::Implementation::Reactor::Add(int fd, ReactorWaiter* waiter, uint32_t events)
+{
+  uint64_t id = NextId++;
+
+  Shard* shard = GetShard(size_t(id), true);
+  if (shard == nullptr)
+    return false;
+
+  waiter->Id = id;
+  waiter->Shard = size_t(id);
+
+  if (true)
+  {
+    std::lock_guard guard(shard->Lock);
+    shard->Waiters[id] = waiter;
+  }
+
+  epoll_event ev{};
+  ev.data.u64 = id;
+  ev.events = events | EPOLLET;
+
+  if (epoll_ctl(shard->Poll, EPOLL_CTL_ADD, fd, &ev) == -1)
+  {
+    LogosE("epoll_ctl(EPOLL_CTL_ADD) failed");
+
+    std::lock_guard guard(shard->Lock);
+    shard->Waiters.erase(id);
+
+    waiter->Id = 0;
+    return false;
+  }
+
+  return true;
+}
+
+bool Syncme::Implementation::Reactor::Update(int fd, ReactorWaiter* waiter, uint32_t events)
+{
+  if (waiter->Id == 0)
+    return false;
+
+  Shard* shard = GetShard(waiter->Shard, false);
+  if (shard == nullptr)
+    return false;
+
+  epoll_event ev{};
+  ev.data.u64 = waiter->Id;
+  ev.events = events | EPOLLET;
+
+  if (epoll_ctl(shard->Poll, EPOLL_CTL_MOD, fd, &ev) == -1)
+  {
+    LogosE("epoll_ctl(EPOLL_CTL_MOD) failed");
+    return false;
+  }
+
+  return true;
+}
+
+void Syncme::Implementation::Reactor::Remove(int fd, ReactorWaiter* waiter)
+{
+  if (waiter->Id == 0)
+    return;
+
+  Shard* shard = GetShard(waiter->Shard, false);
+  if (shard)
+  {
+    if (epoll_ctl(shard->Poll, EPOLL_CTL_DEL, fd, nullptr) == -1)
+    {
+      LogosE("epoll_ctl(EPOLL_CTL_DEL) failed");
+    }
+
+    // The thread can process an event which was returned before
+    // EPOLL_CTL_DEL. It does it holding the lock
+    std::lock_guard guard(shard->Lock);
+    shard->Waiters.erase(waiter->Id);
+  }
+
+  waiter->Id = 0;
+}
+
+size_t Syncme::Implementation::Reactor::GetDescriptors()
+{
+  std::lock_guard guard(DataLock);
+  return Shards.size() * 2;
+}
+
+void Syncme::Implementation::Reactor::Uninitialize()
+{
+  std::lock_guard guard(DataLock);
+
+  for (Shard* shard : Shards)
+    FreeShard(shard);
+
+  Shards.clear();
+}
+
+#else
+
+bool Syncme::Implementation::Reactor::Add(int fd, ReactorWaiter* waiter, uint32_t events)
+{
+  return false;
+}
+
+bool Syncme::Implementation::Reactor::Update(int fd, ReactorWaiter* waiter, uint32_t events)
+{
+  return false;
+}
+
+void Syncme::Implementation::Reactor::Remove(int fd, ReactorWaiter* waiter)
+{
+}
+
+size_t Syncme::Implementation::Reactor::GetDescriptors()
+{
+  return 0;
+}
+
+void Syncme::Implementation::Reactor::Uninitialize()
+{
+}
+
+#endif
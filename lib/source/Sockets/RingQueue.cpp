@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cassert>
+#include <string.h>
+
+#include <Syncme/Sockets/RingQueue.h>
+
+using namespace Syncme;
+using namespace Syncme::Sockets::IO;
+
+static size_t RoundCapacity(size_t capacity)
+{
+  size_t n = 1;
+  while (n < capacity)
+    n <<= 1;
+
+  return n;
+}
+
+RingQueue::RingQueue(size_t capacity)
+  : Capacity(RoundCapacity(std::max(capacity, size_t(1))))
+  , Mask(Capacity - 1)
+  , Head(0)
+  , Tail(0)
+{
+  Data.reset(new char[Capacity]);
+}
+
+size_t RingQueue::GetCapacity() const
+{
+  return Capacity;
+}
+
+size_t RingQueue::Size() const
+{
+  // Head is loaded first, so the difference can not be negative
+  size_t head = Head.load(std::memory_order_acquire);
+  size_t tail = Tail.load(std::memory_order_acquire);
+  return tail - head;
+}
+
+bool RingQueue::IsEmpty() const
+{
+  return Size() == 0;
+}
+
+bool RingQueue::GetAvailableLimit(size_t& available) const
+{
+  available = Capacity - Size();
+  return true;
+}
+
+char* RingQueue::Reserve(size_t& size)
+{
+  size_t tail = Tail.load(std::memory_order_relaxed);
+  size_t head = Head.load(std::memory_order_acquire);
+
+  size_t free = Capacity - (tail - head);
+  size_t pos = tail & Mask;
+
+  size = std::min(free, Capacity - pos);
+  return size ? &Data[pos] : nullptr;
+}
+
+void RingQueue::Commit(size_t n)
+{
+  size_t tail = Tail.load(std::memory_order_relaxed);
+  assert(n <= Capacity - (tail - Head.load(std::memory_order_acquire)));
+
+  Tail.store(tail + n, std::memory_order_release);
+}
+
+bool RingQueue::Append(const void* p, size_t cb, size_t* qsize)
+{
+  assert(p);
+
+  size_t tail = Tail.load(std::memory_order_relaxed);
+  size_t head = Head.load(std::memory_order_acquire);
+
+  if (qsize)
+    *qsize = tail - head;
+
+  if (cb > Capacity - (tail - head))
+    return false;
+
+  size_t pos = tail & Mask;
+  size_t first = std::min(cb, Capacity - pos);
+
+  memcpy(&Data[pos], p, first);
+  memcpy(&Data[0], (const char*)p + first, cb - first);
+
+  Tail.store(tail + cb, std::memory_order_release);
+
+  if (qsize)
+    *qsize += cb;
+
+  return true;
+}
+
+size_t RingQueue::GetSpans(Span* spans, size_t count) const
+{
+  size_t head = Head.load(std::memory_order_relaxed);
+  size_t tail = Tail.load(std::memory_order_acquire);
+
+  size_t size = tail - head;
+  if (size == 0 || count == 0)
+    return 0;
+
+  size_t pos = head & Mask;
+  size_t first = std::min(size, Capacity - pos);
+
+  spans[0].Data = &Data[pos];
+  spans[0].Size = first;
+
+  if (first == size || count == 1)
+    return 1;
+
+  spans[1].Data = &Data[0];
+  spans[1].Size = size - first;
+  return 2;
+}
+
+void RingQueue::Consume(size_t n)
+{
+  size_t head = Head.load(std::memory_order_relaxed);
+  assert(n <= Tail.load(std::memory_order_acquire) - head);
+
+  Head.store(head + n, std::memory_order_release);
+}
+
+size_t RingQueue::Read(void* p, size_t cb)
+{
+  Span spans[2];
+  size_t count = GetSpans(spans, 2);
+
+  size_t n = 0;
+  for (size_t i = 0; i < count && n < cb; ++i)
+  {
+    size_t part = std::min(spans[i].Size, cb - n);
+    memcpy((char*)p + n, spans[i].Data, part);
+    n += part;
+  }
+
+  Consume(n);
+  return n;
+}
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cassert>
+#include <string.h>
 #include <Syncme/Sockets/OsslCompat.h>
 
 #include <openssl/err.h>
@@ -18,12 +20,19 @@
 
 using namespace Syncme;
 
+// Maximal size of plaintext in a TLS record
+constexpr static size_t RECORD_SIZE = 16384;
+
 SSLSocket::SSLSocket(SocketPair* pair, SSL* ssl)
   : Socket(pair)
   , Ssl(ssl)
   , AsyncTlsAutoHandshake(true)
 {
   assert(Ssl);
+
+  // A retry of SSL_write() may get the same data in the coalescing 
+  // buffer instead of the queued one
+  SSL_set_mode(Ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 }
 
 SSLSocket::~SSLSocket()
@@ -40,6 +49,11 @@ std::string SSLSocket::GetProtocol() const
   return SSL_get_version(Ssl);
 }
 
+size_t SSLSocket::GetObjectSize() const
+{
+  return sizeof(SSLSocket);
+}
+
 void SSLSocket::Shutdown()
 {
   LogI("Shutting down connection...");
@@ -179,6 +193,29 @@ int SSLSocket::InternalWrite(const void* buffer, size_t size, int timeout)
   return TranslateSSLError(n, "SSL_write");
 }
 
+int SSLSocket::InternalWriteV(const Sockets::IO::Span* spans, size_t count)
+{
+  if (count == 1 || spans[0].Size >= RECORD_SIZE)
+    return InternalWrite(spans[0].Data, spans[0].Size, 0);
+
+  // Small queued buffers are joined, so they are sent as one TLS record
+  // instead of a record per buffer. The buffer is filled greedily from
+  // the head of the queue, so a retry after WOULDBLOCK gets the same
+  // bytes followed by data which was queued in the meantime
+  static thread_local std::vector<char> record;
+  record.resize(RECORD_SIZE);
+
+  size_t size = 0;
+  for (size_t i = 0; i < count && size < RECORD_SIZE; ++i)
+  {
+    size_t n = std::min(spans[i].Size, RECORD_SIZE - size);
+    memcpy(&record[size], spans[i].Data, n);
+    size += n;
+  }
+
+  return InternalWrite(record.data(), size, 0);
+}
+
 int SSLSocket::InternalRead(void* buffer, size_t size, int timeout)
 {
   SKT_SET_LAST_ERROR(NONE);
@@ -47,7 +47,9 @@ Socket::Socket(SocketPair* pair, int handle, bool enableClose)
   , AcceptPort(0)
   , Pid(-1)
   , RxQueue(-1)
+  , RxReadSize(Sockets::IO::MIN_READ_SIZE)
   , TxQueue(-1)
+  , FailLogged(false)
 #ifdef _WIN32
   , WBreakWait(nullptr)
 #if SKTCOUNTERS
@@ -63,10 +65,9 @@ Socket::Socket(SocketPair* pair, int handle, bool enableClose)
   , EventDescriptor(-1)
   , EventsMask(0)
   , EpollMask(0)
+  , SharedReactor(false)
 #endif
-  , FailLogged(false)
 {
-  RxBuffer[0] = '\0';
   StartTX = CreateSynchronizationEvent();
 
 #ifdef _WIN32
@@ -85,6 +86,10 @@ Socket::Socket(SocketPair* pair, int handle, bool enableClose)
     std::bind(&Socket::EventSignalled, this, WAIT_RESULT::OBJECT_4, _1, _2)
   );
 
+  SharedReactor = Pair->GetConfig()->GetBool("shared_reactor", false);
+  if (SharedReactor)
+    return;
+
   Poll = epoll_create(1);
   if (Poll == -1)
   {
@@ -182,6 +187,26 @@ Socket::~Socket()
 #endif
 }
 
+SocketMemory Socket::GetMemoryUsage() const
+{
+  SocketMemory m{};
+  m.Object = GetObjectSize();
+
+  size_t cached = 0;
+  RxQueue.GetMemoryUsage(m.RxQueued, cached);
+  m.Cached += cached;
+
+  TxQueue.GetMemoryUsage(m.TxQueued, cached);
+  m.Cached += cached;
+
+  return m;
+}
+
+size_t Socket::GetObjectSize() const
+{
+  return sizeof(Socket);
+}
+
 const IOCounters& Socket::GetTotals()
 {
   return Totals;
@@ -271,12 +296,19 @@ int Socket::Detach(bool* enableClose)
       CloseEventCookie = 0;
     }
 
-    epoll_event ev{};
-    ev.data.fd = Handle;
-    ev.events |= EPOLLIN;
-    if (epoll_ctl(Poll, EPOLL_CTL_DEL, Handle, &ev) == -1)
+    if (SharedReactor)
     {
-      LogosE("epoll_ctl(EPOLL_CTL_DEL) failed for Handle");
+      Implementation::Reactor::Remove(Handle, &Waiter);
+    }
+    else
+    {
+      epoll_event ev{};
+      ev.data.fd = Handle;
+      ev.events |= EPOLLIN;
+      if (epoll_ctl(Poll, EPOLL_CTL_DEL, Handle, &ev) == -1)
+      {
+        LogosE("epoll_ctl(EPOLL_CTL_DEL) failed for Handle");
+      }
     }
   }
 #endif
@@ -345,7 +377,24 @@ bool Socket::Attach(int socket, bool enableClose)
   ev.data.fd = Handle;
   ev.events = EPOLLIN | EPOLLRDHUP;
 
-  if (epoll_ctl(Poll, EPOLL_CTL_ADD, Handle, &ev) == -1)
+  if (SharedReactor)
+  {
+    if (Handle != -1)
+    {
+      // IO() would wait for the waiter forever
+      if (Implementation::Reactor::Add(Handle, &Waiter, ev.events) == false)
+      {
+        LogosE("Reactor::Add failed for Handle");
+        SKT_SET_LAST_ERROR(GENERIC);
+
+        Detach();
+        return false;
+      }
+
+      EpollMask = ev.events;
+    }
+  }
+  else if (epoll_ctl(Poll, EPOLL_CTL_ADD, Handle, &ev) == -1)
   {
     LogosE("epoll_ctl(EPOLL_CTL_ADD) failed for Handle");
   }
@@ -6,6 +6,7 @@
 #include <fcntl.h>
 #endif
 
+#include <Syncme/Affinity.h>
 #include <Syncme/Logger/Log.h>
 #include <Syncme/Sockets/API.h>
 #include <Syncme/Sockets/Counter.h>
@@ -426,6 +427,7 @@ void SocketEventQueue::Worker()
 {
 #ifndef _WIN32
   SET_CUR_THREAD_NAME("SktEvQueueWorker");
+  ApplyRuntimeAffinity();
 
   while (GetEventState(EvStop) != STATE::SIGNALLED)
   {
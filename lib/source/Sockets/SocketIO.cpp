@@ -1,15 +1,37 @@
+#include <algorithm>
 #include <cassert>
 #include <string.h>
 
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sockets/BufferPool.h>
 #include <Syncme/Sockets/SocketPair.h>
 #include <Syncme/Sockets/Socket.h>
 #include <Syncme/TickCount.h>
 #include <Syncme/TimePoint.h>
 
+#include <limits.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #pragma warning(disable : 6262)
 
 using namespace Syncme;
 
+// Maximal number of queued buffers sent by one call
+#ifdef IOV_MAX
+constexpr static size_t WRITE_SPANS = IOV_MAX;
+#else
+constexpr static size_t WRITE_SPANS = 1024;
+#endif
+
+// Size of a file window mapped by InternalSendFile()
+constexpr static size_t SEND_FILE_WINDOW = 1024 * 1024;
+
 uint32_t Socket::CalculateTimeout(int timeout, uint64_t start, bool& expired)
 {
   auto t = Syncme::GetTimeInMillisec();
@@ -87,52 +109,215 @@ void Socket::IoDebug(IOStat& stat, const char* op, int n, const char* tn)
 }
 #endif
 
+int Socket::InternalWriteV(const Sockets::IO::Span* spans, size_t count)
+{
+  (void)count;
+  assert(count);
+  return InternalWrite(spans[0].Data, spans[0].Size, 0);
+}
+
+PendingFile::PendingFile(int fd, uint64_t offset, uint64_t length, size_t before)
+  : Fd(fd)
+  , Offset(offset)
+  , Left(length)
+  , Before(before)
+  , Map(nullptr)
+  , MapOffset(0)
+  , MapSize(0)
+{
+}
+
+PendingFile::~PendingFile()
+{
+#ifndef _WIN32
+  if (Map)
+    munmap(Map, MapSize);
+
+  if (Fd != -1)
+    close(Fd);
+#endif
+}
+
+bool Socket::SendFile(int fd, uint64_t offset, uint64_t length)
+{
+  if (length == 0)
+    return true;
+
+  if (Handle == -1 || fd == -1)
+  {
+    SKT_SET_LAST_ERROR(GENERIC);
+    return false;
+  }
+
+#ifdef _WIN32
+  LogE("SendFile is not supported");
+  SKT_SET_LAST_ERROR(GENERIC);
+  return false;
+#else
+  std::lock_guard lock(TxLock);
+
+  int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (copy == -1)
+  {
+    LogosE("fcntl(F_DUPFD_CLOEXEC) failed");
+    SKT_SET_LAST_ERROR(GENERIC);
+    return false;
+  }
+
+  // Queued data is sent before the file. Bytes which are ahead of
+  // earlier files are already counted by them
+  size_t before = TxQueue.BufferedSize();
+  for (auto& f : TxFiles)
+    before -= f.Before;
+
+  TxFiles.emplace_back(copy, offset, length, before);
+
+  // Counted under TxLock: WriteIO() can not remove the bytes before they
+  // are added and Write() does not pass the file. Wakes up the IO loop
+  TxQueue.AddExternal(size_t(length));
+
+  SKT_SET_LAST_ERROR(NONE);
+  return true;
+#endif
+}
+
+int Socket::InternalSendFile(PendingFile& file)
+{
+#ifdef _WIN32
+  SKT_SET_LAST_ERROR(GENERIC);
+  return -1;
+#else
+  // Mapped window is reused until all of its bytes are sent
+  if (file.Map == nullptr
+    || file.Offset < file.MapOffset
+    || file.Offset >= file.MapOffset + file.MapSize
+  )
+  {
+    if (file.Map)
+    {
+      munmap(file.Map, file.MapSize);
+      file.Map = nullptr;
+    }
+
+    static const uint64_t page = uint64_t(sysconf(_SC_PAGESIZE));
+    uint64_t start = file.Offset - file.Offset % page;
+    size_t size = size_t(std::min<uint64_t>(file.Offset - start + file.Left, SEND_FILE_WINDOW));
+
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, file.Fd, off_t(start));
+    if (p == MAP_FAILED)
+    {
+      LogosE("mmap failed");
+      SKT_SET_LAST_ERROR(IO_INCOMPLETE);
+      return -1;
+    }
+
+    file.Map = p;
+    file.MapOffset = start;
+    file.MapSize = size;
+  }
+
+  // Pages beyond the end of the file can not be read
+  struct stat st{};
+  if (fstat(file.Fd, &st) == -1 || uint64_t(st.st_size) < file.Offset + 1)
+  {
+    LogE("file is shorter than requested");
+    SKT_SET_LAST_ERROR(IO_INCOMPLETE);
+    return -1;
+  }
+
+  size_t skip = size_t(file.Offset - file.MapOffset);
+  size_t size = std::min<size_t>(file.MapSize - skip, size_t(uint64_t(st.st_size) - file.Offset));
+  size = std::min<size_t>(size, INT_MAX);
+
+  return InternalWrite((const char*)file.Map + skip, size, 0);
+#endif
+}
+
+// Cuts spans to the first limit bytes. Returns the number of spans
+static size_t LimitSpans(Sockets::IO::Span* spans, size_t count, size_t limit)
+{
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (total + spans[i].Size >= limit)
+    {
+      spans[i].Size = limit - total;
+      return i + 1;
+    }
+
+    total += spans[i].Size;
+  }
+
+  return count;
+}
+
 bool Socket::WriteIO(IOStat& stat)
 {
   TimePoint t0;
   std::lock_guard lock(TxLock);
 
+  static thread_local Sockets::IO::Span spans[WRITE_SPANS];
+
   for (;;)
   {
-    auto b = TxQueue.PopFirst();
-    if (b == nullptr)
-      break;
+    int n = 0;
 
-    size_t size = b->size();
-    int n = InternalWrite(b->data(), size, 0);
-    IODEBUG("tx", n);
+    // File is sent when all data queued before it is sent
+    if (TxFiles.empty() == false && TxFiles.front().Before == 0)
+    {
+      auto& file = TxFiles.front();
 
-    if (n > 0)
+      n = InternalSendFile(file);
+      IODEBUG("txf", n);
+
+      if (n > 0)
+      {
+        file.Offset += uint64_t(n);
+        file.Left -= uint64_t(n);
+        TxQueue.RemoveExternal(size_t(n));
+
+        if (file.Left == 0)
+          TxFiles.pop_front();
+      }
+    }
+    else
     {
-      if (n < size)
+      // Partially sent buffer stays in the queue, the queue keeps
+      // the offset of the first unsent byte
+      size_t count = TxQueue.GetSpans(spans, WRITE_SPANS);
+      if (count == 0)
+        break;
+
+      // Data queued after a file is not sent before it
+      if (TxFiles.empty() == false)
+        count = LimitSpans(spans, count, TxFiles.front().Before);
+
+      n = InternalWriteV(spans, count);
+      IODEBUG("tx", n);
+
+      if (n > 0)
       {
-        memmove(&(*b)[0], &(*b)[n], size - n);
-        b->resize(size - n);
+        TxQueue.Consume(size_t(n));
 
-        TxQueue.PushFront(b, false);
+        if (TxFiles.empty() == false)
+          TxFiles.front().Before -= size_t(n);
       }
-      else
-        TxQueue.PushFree(b);
+    }
 
+    if (n > 0)
+    {
       stat.Sent += n;
       stat.SentPkt++;
 
       continue;
     }
 
-    if (b->size())
-    {
-      TxQueue.PushFront(b, false);
-    }
-    else
-      TxQueue.PushFree(b);
-
     if (n < 0)
     {
       if (FailLogged == false)
       {
         char buffer[256]{};
-        sprintf(buffer, "failed to send %zu bytes to %s", size, Pair->WhoAmI(this));
+        sprintf(buffer, "failed to send %zu bytes to %s", TxQueue.Size(), Pair->WhoAmI(this));
         LogIoError("", buffer);
 
         FailLogged = true;
@@ -155,7 +340,7 @@ bool Socket::ReadIO(IOStat& stat)
   
   for (;;)
   {
-    size_t readSize = Sockets::IO::BUFFER_SIZE;
+    size_t readSize = RxReadSize;
     size_t available = 0;
 
     if (RxQueue.GetAvailableLimit(available))
@@ -167,7 +352,17 @@ bool Socket::ReadIO(IOStat& stat)
         readSize = available;
     }
 
-    int n = InternalRead(RxBuffer, readSize, 0);
+    // Data is received directly into a pooled buffer which is passed to
+    // RxQueue as is. Growing of a vector zeroes the added part, so the
+    // size of reads follows the size of received data. The buffer is
+    // taken from the size class of the read, so small messages left
+    // unread do not keep BUFFER_SIZE buffers
+    Sockets::IO::BufferPtr b = Sockets::IO::AllocateBuffer(readSize);
+
+    if (b->size() < readSize)
+      b->resize(readSize);
+
+    int n = InternalRead(b->data(), readSize, 0);
     IODEBUG("rx", n);
 
     if (n > 0)
@@ -175,12 +370,22 @@ bool Socket::ReadIO(IOStat& stat)
       stat.Rcv += n;
       stat.RcvPkt++;
 
+      b->resize(n);
+
       size_t qsize = 0;
-      RxQueue.Append(RxBuffer, n, &qsize);
+      RxQueue.Append(b, &qsize);
+
+      RxReadSize = std::clamp(
+        size_t(n) * 2
+        , Sockets::IO::MIN_READ_SIZE
+        , Sockets::IO::BUFFER_SIZE
+      );
 
       continue;
     }
 
+    Sockets::IO::ReleaseScratchBuffer(b);
+
     if (n < 0)
     {
       stat.RcvTime += t0.ElapsedSince();
@@ -255,15 +460,41 @@ int Socket::Read(void* buffer, size_t size, int timeout)
   if (cb > size)
   {
     SKT_SET_LAST_ERROR(IO_INCOMPLETE);
-    RxQueue.PushFree(b);
+    ReleaseBuffer(b);
     return -1;
   }
 
   memcpy(buffer, b->data(), cb);
-  RxQueue.PushFree(b);
+  ReleaseBuffer(b);
   return int(cb);
 }
 
+Sockets::IO::BufferPtr Socket::ReadBuffer(int timeout)
+{
+  IOStat stat{};
+  IO(timeout, stat);
+
+  return RxQueue.PopFirst();
+}
+
+int Socket::ReadV(Sockets::Async::BufferChain& chain, size_t size, int timeout)
+{
+  IOStat stat{};
+  bool f = IO(timeout, stat);
+
+  size_t n = RxQueue.MoveTo(chain, std::min(size, size_t(INT_MAX)));
+  if (n == 0)
+    return f ? 0 : -1;
+
+  return int(n);
+}
+
+void Socket::ReleaseBuffer(Sockets::IO::BufferPtr buffer)
+{
+  if (buffer)
+    Sockets::IO::ReleaseScratchBuffer(buffer);
+}
+
 int Socket::Read(std::vector<char>& buffer, int timeout)
 {
   return Read(&buffer[0], buffer.size(), timeout);
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cassert>
+#include <limits.h>
 
 #include <Syncme/Sockets/API.h>
 #include <Syncme/Sockets/OsslCompat.h>
@@ -92,6 +94,24 @@ int SocketPair::PeerDisconnected()
   return int(PEER_DISCONNECT_TIMEOUT);
 }
 
+size_t SocketPair::GetMemoryUsage()
+{
+  std::lock_guard<std::mutex> lock(CloseLock);
+
+  size_t total = sizeof(SocketPair);
+
+  for (auto& socket : {Client, Server})
+  {
+    if (socket == nullptr)
+      continue;
+
+    SocketMemory m = socket->GetMemoryUsage();
+    total += m.Object + m.RxQueued + m.TxQueued + m.Cached;
+  }
+
+  return total;
+}
+
 bool SocketPair::IsDisconnected()
 {
   std::lock_guard<std::mutex> lock(CloseLock);
@@ -207,6 +227,7 @@ int SocketPair::IO(
   SocketPtr socket
   , void* buffer
   , size_t size
+  , Sockets::Async::BufferChain* chain
   , SocketPtr& from
   , int timeout
 )
@@ -218,6 +239,15 @@ int SocketPair::IO(
     return -1;
   }
 
+  if (chain)
+  {
+    size_t n = socket->RxQueue.MoveTo(*chain, std::min(size, size_t(INT_MAX)));
+    if (n)
+      from = socket;
+
+    return int(n);
+  }
+
   auto b = socket->RxQueue.Join(size);
   if (b != nullptr)
   {
@@ -230,7 +260,7 @@ int SocketPair::IO(
     memcpy(buffer, b->data(), b->size());
     int n = int(b->size());
 
-    socket->RxQueue.PushFree(b);
+    socket->ReleaseBuffer(b);
     from = socket;
     return n;
   }
@@ -239,6 +269,22 @@ int SocketPair::IO(
 }
 
 int SocketPair::Read(void* buffer, size_t size, SocketPtr& from, int timeout)
+{
+  return ReadInternal(buffer, size, nullptr, from, timeout);
+}
+
+int SocketPair::ReadV(Sockets::Async::BufferChain& chain, size_t size, SocketPtr& from, int timeout)
+{
+  return ReadInternal(nullptr, size, &chain, from, timeout);
+}
+
+int SocketPair::ReadInternal(
+  void* buffer
+  , size_t size
+  , Sockets::Async::BufferChain* chain
+  , SocketPtr& from
+  , int timeout
+)
 {
   auto start = GetTimeInMillisec();
 
@@ -253,10 +299,10 @@ int SocketPair::Read(void* buffer, size_t size, SocketPtr& from, int timeout)
     return -1;
 
   if (clientValid && !serverValid)
-    return IO(Client, buffer, size, from, timeout);
+    return IO(Client, buffer, size, chain, from, timeout);
 
   if (serverValid && !clientValid)
-    return IO(Server, buffer, size, from, timeout);
+    return IO(Server, buffer, size, chain, from, timeout);
  
   EventArray events(
     GetExitEvent()
@@ -277,13 +323,13 @@ int SocketPair::Read(void* buffer, size_t size, SocketPtr& from, int timeout)
 
   for (int loops = 0, zeroCnt = 0;; ++loops)
   {
-    n = IO(Client, buffer, size, from, 0);
+    n = IO(Client, buffer, size, chain, from, 0);
     if (n != 0)
     {
       return n;
     }
 
-    n = IO(Server, buffer, size, from, 0);
+    n = IO(Server, buffer, size, chain, from, 0);
     if (n != 0)
     {
       return n;
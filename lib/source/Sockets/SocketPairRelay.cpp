@@ -0,0 +1,358 @@
+#include <Syncme/Event/Event.h>
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/BIOSocket.h>
+#include <Syncme/Sockets/SocketPair.h>
+#include <Syncme/TickCount.h>
+
+using namespace Syncme;
+
+#ifndef _WIN32
+
+#include <mutex>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Data which was already received to user space is written to the peer
+// before the sockets are spliced. Flush() takes IOLock of the peer, so
+// IOLock of the source is released before it
+static bool MoveReceived(Socket* from, Socket* to, uint64_t& bytes)
+{
+  if (true)
+  {
+    std::lock_guard<std::mutex> guard(from->IOLock);
+
+    for (auto& p : from->Packets)
+    {
+      if (to->Write(p->data(), p->size()) < 0)
+        return false;
+
+      bytes += p->size();
+    }
+
+    from->Packets.clear();
+
+    for (;;)
+    {
+      auto b = from->RxQueue.PopFirst();
+      if (b == nullptr)
+        break;
+
+      size_t size = b->size();
+      int n = to->Write(b->data(), size);
+      from->ReleaseBuffer(b);
+
+      if (n < 0)
+        return false;
+
+      bytes += size;
+    }
+  }
+
+  while (to->TxQueue.IsEmpty() == false)
+  {
+    if (to->Flush() == false)
+      return false;
+  }
+
+  return true;
+}
+
+// Data in user space which has to be moved before splicing
+static bool HasUserData(Socket* s)
+{
+  return s->Packets.empty() == false
+    || s->RxQueue.IsEmpty() == false
+    || s->TxQueue.IsEmpty() == false;
+}
+
+namespace
+{
+  // Requested capacity of a pipe. The default one is 64K
+  constexpr static int RELAY_PIPE_SIZE = 1024 * 1024;
+
+  constexpr static uint64_t STOP_ID = 0;
+
+  struct RelayDirection
+  {
+    int From;
+    int To;
+    int Pipe[2];
+    size_t Capacity;
+    size_t Pending;   // bytes in the pipe
+    bool Eof;
+    bool Shutdown;
+    uint64_t* Bytes;
+
+    RelayDirection(int from, int to, uint64_t* bytes)
+      : From(from)
+      , To(to)
+      , Pipe{-1, -1}
+      , Capacity(0)
+      , Pending(0)
+      , Eof(false)
+      , Shutdown(false)
+      , Bytes(bytes)
+    {
+    }
+
+    ~RelayDirection()
+    {
+      if (Pipe[0] != -1)
+        close(Pipe[0]);
+
+      if (Pipe[1] != -1)
+        close(Pipe[1]);
+    }
+
+    bool Open()
+    {
+      if (pipe2(Pipe, O_NONBLOCK | O_CLOEXEC) == -1)
+        return false;
+
+      // Larger pipe means fewer splice() calls. Failure is not an error
+      fcntl(Pipe[1], F_SETPIPE_SZ, RELAY_PIPE_SIZE);
+
+      int size = fcntl(Pipe[1], F_GETPIPE_SZ);
+      Capacity = size > 0 ? size_t(size) : 65536;
+      return true;
+    }
+
+    // Returns 1 if some data was moved, 0 if nothing to do and -1 on
+    // error
+    int Pump()
+    {
+      bool progress = false;
+
+      for (;;)
+      {
+        bool moved = false;
+
+        if (Eof == false && Pending < Capacity)
+        {
+          ssize_t n = splice(
+            From
+            , nullptr
+            , Pipe[1]
+            , nullptr
+            , Capacity - Pending
+            , SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+          );
+
+          if (n > 0)
+          {
+            Pending += size_t(n);
+            moved = true;
+          }
+          else if (n == 0)
+            Eof = true;
+          else if (errno != EAGAIN && errno != EINTR)
+            return -1;
+        }
+
+        if (Pending)
+        {
+          ssize_t n = splice(
+            Pipe[0]
+            , nullptr
+            , To
+            , nullptr
+            , Pending
+            , SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+          );
+
+          if (n > 0)
+          {
+            Pending -= size_t(n);
+            *Bytes += uint64_t(n);
+            moved = true;
+          }
+          else if (n < 0 && errno != EAGAIN && errno != EINTR)
+            return -1;
+        }
+
+        if (moved == false)
+          break;
+
+        progress = true;
+      }
+
+      if (Eof && Pending == 0 && Shutdown == false)
+      {
+        shutdown(To, SHUT_WR);
+        Shutdown = true;
+      }
+
+      return progress ? 1 : 0;
+    }
+  };
+}
+
+bool SocketPair::Relay(RelayStat& stat, int timeout)
+{
+  stat = RelayStat{};
+
+  BIOSocket* client = dynamic_cast<BIOSocket*>(Client.get());
+  BIOSocket* server = dynamic_cast<BIOSocket*>(Server.get());
+
+  if (client == nullptr || server == nullptr || client->Handle == -1 || server->Handle == -1)
+  {
+    LogE("Relay requires two attached plain sockets");
+    return false;
+  }
+
+  // IOLock of both sockets is held while the sockets are spliced, so
+  // IO() of other threads waits for the end of the relay
+  std::unique_lock<std::mutex> clientLock(client->IOLock, std::defer_lock);
+  std::unique_lock<std::mutex> serverLock(server->IOLock, std::defer_lock);
+
+  // Flush() runs IO() which can receive more data to the socket being
+  // flushed, so data is moved until nothing is left in user space
+  for (;;)
+  {
+    if (MoveReceived(client, server, stat.ClientToServer) == false)
+      return false;
+
+    if (MoveReceived(server, client, stat.ServerToClient) == false)
+      return false;
+
+    std::lock(clientLock, serverLock);
+    if (HasUserData(client) == false && HasUserData(server) == false)
+      break;
+
+    clientLock.unlock();
+    serverLock.unlock();
+  }
+
+  RelayDirection c2s(client->Handle, server->Handle, &stat.ClientToServer);
+  RelayDirection s2c(server->Handle, client->Handle, &stat.ServerToClient);
+
+  if (c2s.Open() == false || s2c.Open() == false)
+  {
+    LogosE("pipe2 failed");
+    return false;
+  }
+
+  int poll = epoll_create1(EPOLL_CLOEXEC);
+  int stop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  auto signal = [stop](uint32_t, bool)
+  {
+    uint64_t value = 1;
+    if (write(stop, &value, sizeof(value)) != sizeof(value))
+    {
+      LogosE("write(stop) failed");
+    }
+  };
+
+  uint32_t exitCookie = GetExitEvent()->RegisterWait(signal);
+  uint32_t closeCookie = GetCloseEvent()->RegisterWait(signal);
+
+  bool ok = poll != -1 && stop != -1;
+
+  epoll_event ev{};
+  ev.data.u64 = STOP_ID;
+  ev.events = EPOLLIN;
+
+  if (ok && epoll_ctl(poll, EPOLL_CTL_ADD, stop, &ev) == -1)
+    ok = false;
+
+  // Both directions wait for readability of one socket and writability
+  // of the other, so each socket waits for both
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.u64 = 1;
+
+  if (ok && epoll_ctl(poll, EPOLL_CTL_ADD, client->Handle, &ev) == -1)
+    ok = false;
+
+  ev.data.u64 = 2;
+  if (ok && epoll_ctl(poll, EPOLL_CTL_ADD, server->Handle, &ev) == -1)
+    ok = false;
+
+  if (ok == false)
+    LogosE("Unable to create relay epoll");
+
+  uint64_t active = GetTimeInMillisec();
+  epoll_event events[3];
+
+  while (ok)
+  {
+    if (GetEventState(GetExitEvent()) == STATE::SIGNALLED
+      || GetEventState(GetCloseEvent()) == STATE::SIGNALLED
+    )
+    {
+      Server->SKT_SET_LAST_ERROR(CONNECTION_ABORTED);
+      Client->SKT_SET_LAST_ERROR(CONNECTION_ABORTED);
+      ok = false;
+      break;
+    }
+
+    int r1 = c2s.Pump();
+    int r2 = s2c.Pump();
+
+    if (r1 < 0 || r2 < 0)
+    {
+      (r1 < 0 ? client : server)->SKT_SET_LAST_ERROR(IO_INCOMPLETE);
+      LogosE("splice failed");
+      ok = false;
+      break;
+    }
+
+    if (c2s.Shutdown && s2c.Shutdown)
+      break;
+
+    uint64_t t = GetTimeInMillisec();
+    if (r1 || r2)
+    {
+      active = t;
+      continue;
+    }
+
+    int ms = -1;
+    if (timeout != int(FOREVER))
+    {
+      if (t - active >= uint64_t(timeout))
+      {
+        Server->SKT_SET_LAST_ERROR(TIMEOUT);
+        Client->SKT_SET_LAST_ERROR(TIMEOUT);
+        ok = false;
+        break;
+      }
+
+      ms = int(active + timeout - t);
+    }
+
+    if (epoll_wait(poll, events, 3, ms) < 0 && errno != EINTR)
+    {
+      LogosE("epoll_wait failed");
+      ok = false;
+    }
+  }
+
+  GetExitEvent()->UnregisterWait(exitCookie);
+  GetCloseEvent()->UnregisterWait(closeCookie);
+
+  if (stop != -1)
+    close(stop);
+
+  if (poll != -1)
+    close(poll);
+
+  return ok;
+}
+
+#else
+
+bool SocketPair::Relay(RelayStat& stat, int timeout)
+{
+  stat = RelayStat{};
+
+  LogE("Relay is not supported");
+  return false;
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <cassert>
 
+#include <Syncme/Affinity.h>
 #include <Syncme/Logger/Log.h>
 #include <Syncme/SetThreadName.h>
 #include <Syncme/Sockets/WaitThread.h>
@@ -186,6 +187,7 @@ void WaitThread::TriggerEvent(HANDLE h)
 void WaitThread::Worker()
 {
   SET_CUR_THREAD_NAME("WaitThread");
+  ApplyRuntimeAffinity();
 
   while (true)
   {
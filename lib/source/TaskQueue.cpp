@@ -1,13 +1,286 @@
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <vector>
+
+#include <Syncme/Affinity.h>
+#include <Syncme/Futex.h>
 #include <Syncme/SetThreadName.h>
 #include <Syncme/TaskQueue.h>
+#include <Syncme/TickCount.h>
 
 using namespace Syncme;
 using namespace Syncme::Task;
 
-Queue::Queue()
-  : StopRequested(false)
-  , Worker(&Queue::WorkerProc, this)
+#define STATE_VALUE(s) uint32_t(ITEM_STATE::s)
+
+// Items of a strand which are executed before it goes back to the queue
+static const size_t STRAND_BATCH = 32;
+static const size_t STRANDS_PRUNE_AT = 1024;
+static const uint64_t NO_DUE = uint64_t(-1);
+
+namespace
+{
+  // Free blocks of one size. Threads keep small caches and exchange
+  // blocks with the shared list in batches, so an item allocated by a
+  // producer and released by a worker does not go to the heap
+  template<size_t Size>
+  class BlockPool
+  {
+    static constexpr size_t CACHE = 64;
+    static constexpr size_t BATCH = 32;
+    static constexpr size_t SHARED_LIMIT = 4096;
+
+    struct Shared
+    {
+      std::mutex Lock;
+      std::vector<void*> Blocks;
+    };
+
+    struct Cache
+    {
+      std::vector<void*> Blocks;
+
+      ~Cache()
+      {
+        Release(Blocks.size());
+      }
+
+      void Release(size_t n)
+      {
+        Shared& shared = GetShared();
+        std::lock_guard guard(shared.Lock);
+
+        for (; n; --n)
+        {
+          void* p = Blocks.back();
+          Blocks.pop_back();
+
+          if (shared.Blocks.size() < SHARED_LIMIT)
+            shared.Blocks.push_back(p);
+          else
+            ::operator delete(p);
+        }
+      }
+    };
+
+    // Never destroyed. Items can be released by static destructors
+    static Shared& GetShared()
+    {
+      static Shared* shared = new Shared;
+      return *shared;
+    }
+
+    static Cache& GetCache()
+    {
+      static thread_local Cache cache;
+      return cache;
+    }
+
+  public:
+    static void* Alloc()
+    {
+      Cache& cache = GetCache();
+
+      if (cache.Blocks.empty())
+      {
+        Shared& shared = GetShared();
+        std::lock_guard guard(shared.Lock);
+
+        size_t n = std::min(BATCH, shared.Blocks.size());
+        cache.Blocks.insert(cache.Blocks.end(), shared.Blocks.end() - n, shared.Blocks.end());
+        shared.Blocks.resize(shared.Blocks.size() - n);
+      }
+
+      if (cache.Blocks.empty())
+        return ::operator new(Size);
+
+      void* p = cache.Blocks.back();
+      cache.Blocks.pop_back();
+      return p;
+    }
+
+    static void Free(void* p)
+    {
+      Cache& cache = GetCache();
+      cache.Blocks.push_back(p);
+
+      if (cache.Blocks.size() > CACHE)
+        cache.Release(BATCH);
+    }
+  };
+
+  template<typename T>
+  struct PoolAllocator
+  {
+    typedef T value_type;
+
+    PoolAllocator() = default;
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>&)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+      if (n == 1)
+        return (T*)BlockPool<sizeof(T)>::Alloc();
+
+      return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+      if (n == 1)
+        BlockPool<sizeof(T)>::Free(p);
+      else
+        ::operator delete(p);
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>&) const
+    {
+      return true;
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>&) const
+    {
+      return false;
+    }
+  };
+}
+
+NodeQueue::NodeQueue()
+  : Head(&Stub)
+  , Tail(&Stub)
+{
+}
+
+void NodeQueue::Push(QueueNode* node)
+{
+  node->Next.store(nullptr, std::memory_order_relaxed);
+
+  QueueNode* prev = Head.exchange(node, std::memory_order_acq_rel);
+  prev->Next.store(node, std::memory_order_release);
+}
+
+QueueNode* NodeQueue::Pop()
+{
+  QueueNode* tail = Tail;
+  QueueNode* next = tail->Next.load(std::memory_order_acquire);
+
+  if (tail == &Stub)
+  {
+    if (next == nullptr)
+      return nullptr;
+
+    Tail = next;
+    tail = next;
+    next = next->Next.load(std::memory_order_acquire);
+  }
+
+  if (next)
+  {
+    Tail = next;
+    return tail;
+  }
+
+  // A producer is inside Push()
+  if (tail != Head.load(std::memory_order_acquire))
+    return nullptr;
+
+  Push(&Stub);
+
+  next = tail->Next.load(std::memory_order_acquire);
+  if (next)
+  {
+    Tail = next;
+    return tail;
+  }
+
+  return nullptr;
+}
+
+Strand::Strand(Queue* owner)
+  : Owner(owner)
+  , Count(0)
+{
+  IsStrand = true;
+}
+
+Strand::~Strand()
+{
+}
+
+ItemPtr Strand::Schedule(ItemCallback p, void* context, const char* identifier)
+{
+  return Schedule(Queue::CreateItem(p, context, identifier));
+}
+
+ItemPtr Strand::Schedule(TCallback functor, const char* identifier)
+{
+  return Schedule(Queue::CreateItem(functor, identifier));
+}
+
+ItemPtr Strand::Schedule(ItemPtr item)
+{
+  if (item)
+  {
+    assert(item->State != STATE_VALUE(QUEUED));
+
+    Queue* owner = Owner;
+    if (owner == nullptr || owner->StopRequested)
+    {
+      item->Cancel();
+      return item;
+    }
+
+    item->Self = item;
+    item->State = STATE_VALUE(QUEUED);
+
+    Items.Push(item.get());
+
+    // Idle strand is linked to the queue. Otherwise the worker which
+    // handles the strand takes the item
+    if (Count.fetch_add(1) == 0)
+    {
+      Self = shared_from_this();
+      owner->Push(this);
+    }
+  }
+  return item;
+}
+
+// Count is not zero, so the item is either in the queue or a producer
+// is about to link it
+Item* Strand::PopItem()
 {
+  for (;;)
+  {
+    QueueNode* node = Items.Pop();
+    if (node)
+      return static_cast<Item*>(node);
+
+    std::this_thread::yield();
+  }
+}
+
+Queue::Queue(size_t workers)
+  : Signal(0)
+  , Sleepers(0)
+  , StopRequested(false)
+  , CancelledDelayed(0)
+  , NextDue(NO_DUE)
+  , Merged(0)
+  , StrandsPruneAt(STRANDS_PRUNE_AT)
+  , OwnedPruneAt(STRANDS_PRUNE_AT)
+{
+  workers = std::max<size_t>(1, workers);
+
+  for (size_t i = 0; i < workers; ++i)
+    Workers.emplace_back(&Queue::WorkerProc, this);
 }
 
 Queue::~Queue()
@@ -17,96 +290,519 @@ Queue::~Queue()
 
 void Queue::Stop()
 {
+  StopRequested = true;
+
+  Signal++;
+  FutexWakeAll(Signal);
+
+  for (auto& worker : Workers)
   {
-    std::lock_guard<std::mutex> guard(Lock);
-    StopRequested = true;
+    if (worker.joinable())
+      worker.join();
   }
 
-  Wakeup.notify_one();
+  // Items which were not executed
+  CancelAll();
+  DetachStrands();
+}
+
+ItemPtr Queue::CreateItem(ItemCallback p, void* context, const char* identifier)
+{
+  return std::allocate_shared<Item>(PoolAllocator<Item>(), p, context, identifier);
+}
 
-  if (Worker.joinable())
-    Worker.join();
+ItemPtr Queue::CreateItem(TCallback functor, const char* identifier)
+{
+  return std::allocate_shared<Item>(PoolAllocator<Item>(), functor, identifier);
 }
 
 ItemPtr Queue::Schedule(ItemCallback p, void* context, const char* identifier)
 {
-  ItemPtr item = std::make_shared<Item>(p, context, identifier);
-  return Schedule(item);
+  return Schedule(CreateItem(p, context, identifier));
 }
 
 ItemPtr Queue::Schedule(TCallback functor, const char* identifier)
 {
-  ItemPtr item = std::make_shared<Item>(functor, identifier);
-  return Schedule(item);
+  return Schedule(CreateItem(functor, identifier));
 }
 
 ItemPtr Queue::Schedule(ItemPtr item)
 {
   if (item)
   {
-    bool needWakeup = false;
+    assert(item->State != STATE_VALUE(QUEUED));
 
+    if (StopRequested)
     {
-      std::lock_guard<std::mutex> guard(Lock);
-
-      needWakeup = Items.empty();
-      Items.push_back(item);
+      item->Cancel();
+      return item;
     }
 
-    if (needWakeup)
-      Wakeup.notify_one();
+    item->Self = item;
+    item->State = STATE_VALUE(QUEUED);
+
+    Push(item.get());
   }
   return item;
 }
 
+// The item stays in the queue till a worker skips it
 bool Queue::Cancel(ItemPtr item)
 {
-  std::lock_guard<std::mutex> guard(Lock);
+  uint32_t state = STATE_VALUE(QUEUED);
+  if (!item->State.compare_exchange_strong(state, STATE_VALUE(CANCELLED)))
+  {
+    // Periodic item is being executed. It is not rescheduled
+    if (state == STATE_VALUE(RUNNING) && item->Period.exchange(0))
+      return true;
+
+    return false;
+  }
+
+  // Cancelled item does not keep state of the caller. ScheduleCoalesced()
+  // changes the functor under CoalesceLock
+  if (item->Coalesced)
+  {
+    std::lock_guard guard(CoalesceLock);
+    item->Functor = TCallback();
+  }
+  else
+    item->Functor = TCallback();
+
+  if (true)
+  {
+    std::lock_guard guard(DelayedLock);
+
+    if (item->InDelayed && ++CancelledDelayed * 2 > Delayed.size())
+      Locked_PurgeDelayed();
+  }
+
+  item->Cancel();
+  return true;
+}
+
+ItemPtr Queue::ScheduleCoalesced(
+  const char* identifier
+  , TCallback functor
+  , COALESCE_MODE mode
+)
+{
+  std::lock_guard guard(CoalesceLock);
+
+  auto& entry = Coalesced[identifier];
+
+  // Workers remove the entry before they start the item, so its functor
+  // can be changed here
+  if (entry && entry->State == STATE_VALUE(QUEUED))
+  {
+    if (mode == COALESCE_MODE::REPLACE)
+      entry->Functor = functor;
+
+    Merged++;
+    return entry;
+  }
+
+  ItemPtr item = CreateItem(functor, identifier);
+  item->Coalesced = true;
+
+  entry = item;
+  return Schedule(item);
+}
+
+bool Queue::Cancel(const std::string& identifier)
+{
+  ItemPtr item;
+
+  if (true)
+  {
+    std::lock_guard guard(CoalesceLock);
+
+    auto it = Coalesced.find(identifier);
+    if (it == Coalesced.end())
+      return false;
+
+    item = it->second;
+    Coalesced.erase(it);
+  }
+
+  return Cancel(item);
+}
+
+uint64_t Queue::GetMerged() const
+{
+  return Merged;
+}
+
+ItemPtr Queue::ScheduleAfter(uint32_t ms, TCallback functor, const char* identifier)
+{
+  ItemPtr item = CreateItem(functor, identifier);
+  item->Due = GetTimeInMillisec() + ms;
+  item->State = STATE_VALUE(QUEUED);
+
+  AddDelayed(item);
+  return item;
+}
+
+ItemPtr Queue::ScheduleEvery(uint32_t ms, TCallback functor, const char* identifier)
+{
+  ItemPtr item = CreateItem(functor, identifier);
+  item->Due = GetTimeInMillisec() + ms;
+  item->Period = std::max<uint32_t>(1, ms);
+  item->State = STATE_VALUE(QUEUED);
+
+  AddDelayed(item);
+  return item;
+}
+
+static bool DueLater(const ItemPtr& a, const ItemPtr& b)
+{
+  return a->Due > b->Due;
+}
+
+void Queue::AddDelayed(ItemPtr item)
+{
+  if (StopRequested)
+  {
+    item->Cancel();
+    return;
+  }
 
-  for (auto it = Items.begin(); it != Items.end(); ++it)
+  if (true)
   {
-    if (*it == item)
+    std::lock_guard guard(DelayedLock);
+
+    item->InDelayed = true;
+    Delayed.push_back(item);
+    std::push_heap(Delayed.begin(), Delayed.end(), DueLater);
+
+    // Sleeping workers have to recalculate their timeout
+    if (Delayed.front() != item)
+      return;
+
+    NextDue = item->Due;
+  }
+
+  Signal++;
+  if (Sleepers)
+    FutexWakeOne(Signal);
+}
+
+// Moves due items to the queue. Returns time till the next one
+uint32_t Queue::FireDelayed()
+{
+  uint64_t next = NextDue;
+  if (next == NO_DUE)
+    return FOREVER;
+
+  uint64_t now = GetTimeInMillisec();
+  if (now < next)
+    return uint32_t(std::min<uint64_t>(next - now, FOREVER - 1));
+
+  std::lock_guard guard(DelayedLock);
+
+  while (!Delayed.empty())
+  {
+    ItemPtr item = Delayed.front();
+
+    if (item->State != STATE_VALUE(CANCELLED) && item->Due > now)
+      break;
+
+    std::pop_heap(Delayed.begin(), Delayed.end(), DueLater);
+    Delayed.pop_back();
+    item->InDelayed = false;
+
+    // Item::Cancel() called directly is not counted
+    if (item->State == STATE_VALUE(CANCELLED))
     {
-      item->Cancel();
-      Items.erase(it);
+      if (CancelledDelayed)
+        CancelledDelayed--;
+
+      continue;
+    }
+
+    item->Self = item;
+    Push(item.get());
+  }
+
+  next = Delayed.empty() ? NO_DUE : Delayed.front()->Due;
+  NextDue = next;
+
+  if (next == NO_DUE)
+    return FOREVER;
+
+  return uint32_t(std::min<uint64_t>(next - now, FOREVER - 1));
+}
+
+// Removes cancelled items, so items cancelled long before their due
+// time are not kept till it
+void Queue::Locked_PurgeDelayed()
+{
+  std::erase_if(
+    Delayed
+    , [](const ItemPtr& item)
+    {
+      if (item->State != STATE_VALUE(CANCELLED))
+        return false;
+
+      item->InDelayed = false;
       return true;
     }
+  );
+
+  std::make_heap(Delayed.begin(), Delayed.end(), DueLater);
+  CancelledDelayed = 0;
+
+  // Due time of the top can only grow. Workers which sleep till the old
+  // one wake up and recalculate it
+  NextDue = Delayed.empty() ? NO_DUE : Delayed.front()->Due;
+}
+
+StrandPtr Queue::CreateStrand()
+{
+  std::lock_guard guard(StrandLock);
+  return Locked_CreateStrand();
+}
+
+StrandPtr Queue::Locked_CreateStrand()
+{
+  StrandPtr strand = std::allocate_shared<Strand>(PoolAllocator<Strand>(), this);
+
+  // Drop entries of released strands
+  if (Owned.size() >= OwnedPruneAt)
+  {
+    std::erase_if(Owned, [](const auto& e) { return e.expired(); });
+    OwnedPruneAt = std::max(STRANDS_PRUNE_AT, 2 * Owned.size());
+  }
+
+  Owned.push_back(strand);
+  return strand;
+}
+
+void Queue::DetachStrands()
+{
+  std::lock_guard guard(StrandLock);
+
+  for (auto& e : Owned)
+  {
+    StrandPtr strand = e.lock();
+    if (strand)
+      strand->Owner = nullptr;
+  }
+
+  Owned.clear();
+  Strands.clear();
+}
+
+StrandPtr Queue::GetStrand(const std::string& identifier)
+{
+  std::lock_guard guard(StrandLock);
+
+  // Drop entries of released strands
+  if (Strands.size() >= StrandsPruneAt)
+  {
+    std::erase_if(Strands, [](const auto& e) { return e.second.expired(); });
+    StrandsPruneAt = std::max(STRANDS_PRUNE_AT, 2 * Strands.size());
+  }
+
+  auto& entry = Strands[identifier];
+
+  StrandPtr strand = entry.lock();
+  if (strand == nullptr)
+  {
+    strand = Locked_CreateStrand();
+    entry = strand;
   }
 
-  return false;
+  return strand;
 }
 
-ItemPtr Queue::PopItem()
+ItemPtr Queue::ScheduleOrdered(TCallback functor, const char* identifier)
 {
-  std::unique_lock<std::mutex> guard(Lock);
+  return GetStrand(identifier)->Schedule(functor, identifier);
+}
 
-  Wakeup.wait(
-    guard
-    , [this]()
+void Queue::Push(QueueNode* node)
+{
+  Nodes.Push(node);
+
+  Signal++;
+  if (Sleepers)
+    FutexWakeOne(Signal);
+}
+
+QueueNode* Queue::PopNode()
+{
+  for (;;)
+  {
+    uint32_t signal = Signal;
+    if (StopRequested)
+      return nullptr;
+
+    uint32_t ms = FireDelayed();
+
+    QueueNode* node = nullptr;
+    if (true)
     {
-      return StopRequested || !Items.empty();
+      std::lock_guard guard(PopLock);
+      node = Nodes.Pop();
     }
-  );
 
-  if (StopRequested || Items.empty())
-    return ItemPtr();
+    if (node)
+      return node;
 
-  ItemPtr item = Items.front();
-  Items.pop_front();
+    // A producer changes Signal after its node is linked
+    Sleepers++;
 
-  return item;
+    if (Signal == signal)
+      FutexWait(Signal, signal, ms);
+
+    Sleepers--;
+  }
+}
+
+void Queue::RunItem(Item* p)
+{
+  ItemPtr item;
+  item.swap(p->Self);
+
+  // Skip cancelled items
+  uint32_t state = STATE_VALUE(QUEUED);
+
+  if (item->Coalesced)
+  {
+    std::lock_guard guard(CoalesceLock);
+
+    // The entry could be replaced after the item was cancelled
+    auto it = Coalesced.find(item->Identifier);
+    if (it != Coalesced.end() && it->second == item)
+      Coalesced.erase(it);
+
+    // ScheduleCoalesced() changes the functor only in QUEUED state
+    if (!item->State.compare_exchange_strong(state, STATE_VALUE(RUNNING)))
+      return;
+  }
+  else if (!item->State.compare_exchange_strong(state, STATE_VALUE(RUNNING)))
+    return;
+
+  if (item->Period == 0)
+  {
+    item->Invoke();
+    return;
+  }
+
+  item->Callback(item->Context);
+
+  uint32_t period = item->Period;
+  if (period == 0)
+  {
+    item->Finish(ITEM_STATE::COMPLETED);
+    return;
+  }
+
+  // Missed periods are skipped
+  uint64_t now = GetTimeInMillisec();
+  item->Due += period;
+  if (item->Due <= now)
+    item->Due = now + period;
+
+  item->State = STATE_VALUE(QUEUED);
+  AddDelayed(item);
+
+  // Cancel() could not see QUEUED state and reset the period
+  if (item->Period == 0)
+    Cancel(item);
+}
+
+void Queue::RunStrand(Strand* p)
+{
+  StrandPtr strand;
+  strand.swap(p->Self);
+
+  for (size_t i = 0; i < STRAND_BATCH; ++i)
+  {
+    RunItem(strand->PopItem());
+
+    // Strand is idle. Next Schedule() links it to the queue again
+    if (strand->Count.fetch_sub(1) == 1)
+      return;
+  }
+
+  // Let items of other strands run
+  strand->Self = strand;
+  Push(strand.get());
+}
+
+void Queue::CancelAll()
+{
+  if (true)
+  {
+    std::lock_guard guard(CoalesceLock);
+    Coalesced.clear();
+  }
+
+  std::vector<ItemPtr> delayed;
+
+  if (true)
+  {
+    std::lock_guard guard(DelayedLock);
+
+    delayed.swap(Delayed);
+    CancelledDelayed = 0;
+    NextDue = NO_DUE;
+  }
+
+  for (auto& item : delayed)
+  {
+    uint32_t state = STATE_VALUE(QUEUED);
+    if (item->State.compare_exchange_strong(state, STATE_VALUE(CANCELLED)))
+      item->Cancel();
+  }
+
+  std::lock_guard guard(PopLock);
+
+  while (QueueNode* node = Nodes.Pop())
+  {
+    std::vector<Item*> items;
+
+    if (node->IsStrand)
+    {
+      Strand* p = static_cast<Strand*>(node);
+
+      StrandPtr strand;
+      strand.swap(p->Self);
+
+      while (QueueNode* n = strand->Items.Pop())
+        items.push_back(static_cast<Item*>(n));
+    }
+    else
+      items.push_back(static_cast<Item*>(node));
+
+    for (Item* p : items)
+    {
+      ItemPtr item;
+      item.swap(p->Self);
+
+      uint32_t state = STATE_VALUE(QUEUED);
+      if (item->State.compare_exchange_strong(state, STATE_VALUE(CANCELLED)))
+        item->Cancel();
+    }
+  }
 }
 
 void Queue::WorkerProc()
 {
   SET_CUR_THREAD_NAME("Task::Queue::Worker");
+  ApplyRuntimeAffinity();
 
   for (;;)
   {
-    ItemPtr item = PopItem();
-    if (item == nullptr)
+    QueueNode* node = PopNode();
+    if (node == nullptr)
       break;
 
-    item->Invoke();
+    if (node->IsStrand)
+      RunStrand(static_cast<Strand*>(node));
+    else
+      RunItem(static_cast<Item*>(node));
   }
 }
@@ -1,13 +1,21 @@
+#include <Syncme/Futex.h>
 #include <Syncme/TaskQueue.h>
 
 using namespace Syncme;
 using namespace Syncme::Task;
 
+#define STATE_VALUE(s) uint32_t(ITEM_STATE::s)
+
 Item::Item(ItemCallback p, void* context, const char* identifier)
   : Identifier(identifier)
   , Callback(p)
   , Context(context)
-  , Completed(CreateNotificationEvent())
+  , State(STATE_VALUE(CREATED))
+  , Due(0)
+  , Period(0)
+  , Coalesced(false)
+  , InDelayed(false)
+  , HasEvent(false)
 {
 }
 
@@ -16,7 +24,12 @@ Item::Item(TCallback functor, const char* identifier)
   , Callback(&Item::DefaultCallback)
   , Context(this)
   , Functor(functor)
-  , Completed(CreateNotificationEvent())
+  , State(STATE_VALUE(CREATED))
+  , Due(0)
+  , Period(0)
+  , Coalesced(false)
+  , InDelayed(false)
+  , HasEvent(false)
 {
 }
 
@@ -28,17 +41,58 @@ Item::~Item()
 void Item::Invoke()
 {
   Callback(Context);
-  SetEvent(Completed);
+  Finish(ITEM_STATE::COMPLETED);
 }
 
 void Item::Cancel()
 {
-  SetEvent(Completed);
+  Finish(ITEM_STATE::CANCELLED);
+}
+
+void Item::Finish(ITEM_STATE state)
+{
+  State.store(uint32_t(state));
+  FutexWakeAll(State);
+
+  // Pairs with GetCompletedEvent(): either it sees the final state or
+  // the event is visible here
+  if (HasEvent.load())
+  {
+    std::lock_guard guard(EventLock);
+    SetEvent(Completed);
+  }
 }
 
 void Item::WaitForCompletion() const
 {
-  WaitForSingleObject(Completed);
+  auto& state = const_cast<std::atomic<uint32_t>&>(State);
+
+  for (;;)
+  {
+    uint32_t s = state.load(std::memory_order_acquire);
+
+    // Item which was never scheduled can not be completed
+    if (s == STATE_VALUE(CREATED) || s >= STATE_VALUE(COMPLETED))
+      break;
+
+    FutexWait(state, s);
+  }
+}
+
+HEvent Item::GetCompletedEvent()
+{
+  std::lock_guard guard(EventLock);
+
+  if (Completed == nullptr)
+  {
+    Completed = CreateNotificationEvent();
+    HasEvent.store(true);
+
+    if (State.load() >= STATE_VALUE(COMPLETED))
+      SetEvent(Completed);
+  }
+
+  return Completed;
 }
 
 void Item::DefaultCallback(void* context)
@@ -46,5 +100,3 @@ void Item::DefaultCallback(void* context)
   Item* self = (Item*)context;
   self->Functor();
 }
-
-
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cassert>
+
+#include <Syncme/ThreadPool/Adaptive.h>
+
+using namespace Syncme::ThreadPool;
+
+AdaptiveController::AdaptiveController(const AdaptiveConfig& config)
+  : Config(config)
+  , Limit(config.MinThreads)
+  , Step(std::max<size_t>(1, config.Step))
+  , LastChange(0)
+  , LastThroughput(0)
+{
+  assert(Config.MinThreads > 0);
+  assert(Config.MinThreads <= Config.MaxThreads);
+
+  Config.MinThreads = std::max<size_t>(1, Config.MinThreads);
+  Config.MaxThreads = std::max(Config.MinThreads, Config.MaxThreads);
+  Limit = Config.MinThreads;
+}
+
+const AdaptiveConfig& AdaptiveController::GetConfig() const
+{
+  return Config;
+}
+
+size_t AdaptiveController::GetLimit() const
+{
+  return Limit;
+}
+
+AdaptiveDecision AdaptiveController::Update(const AdaptiveSample& sample)
+{
+  AdaptiveDecision d{};
+  d.Sample = sample;
+  d.Throughput = sample.Interval 
+    ? double(sample.Completed) * 1000.0 / double(sample.Interval) 
+    : 0;
+
+  size_t initialStep = std::max<size_t>(1, Config.Step);
+  size_t maxStep = std::max(initialStep, (Config.MaxThreads - Config.MinThreads) / 4);
+
+  int64_t change = 0;
+
+  if (sample.Completed == 0 && sample.PeakBusy == 0)
+  {
+    d.Reason = ADAPT_REASON::IDLE;
+    change = -int64_t(initialStep);
+    Step = initialStep;
+  }
+  else if (sample.QueueDelay > Config.TargetQueueDelay)
+  {
+    double tolerance = 1.0 - double(Config.Tolerance) / 100.0;
+
+    if (LastChange > 0 && d.Throughput < LastThroughput * tolerance)
+    {
+      // More threads made things worse (contention, CPU saturation)
+      d.Reason = ADAPT_REASON::THROUGHPUT_DROP;
+      change = -LastChange;
+      Step = initialStep;
+    }
+    else
+    {
+      d.Reason = ADAPT_REASON::QUEUEING;
+      change = int64_t(Step);
+
+      if (LastChange > 0)
+        Step = std::min(Step * 2, maxStep);
+    }
+  }
+  else if (sample.PeakBusy + initialStep < Limit)
+  {
+    d.Reason = ADAPT_REASON::UNDERUSED;
+    change = -int64_t(initialStep);
+    Step = initialStep;
+  }
+  else
+  {
+    d.Reason = ADAPT_REASON::STABLE;
+    Step = initialStep;
+  }
+
+  int64_t limit = int64_t(Limit) + change;
+  limit = std::clamp<int64_t>(limit, Config.MinThreads, Config.MaxThreads);
+
+  d.Change = limit - int64_t(Limit);
+  d.Limit = size_t(limit);
+
+  Limit = d.Limit;
+  LastChange = d.Change;
+  LastThroughput = d.Throughput;
+
+  if (Config.TraceSize)
+  {
+    Trace.push_back(d);
+
+    while (Trace.size() > Config.TraceSize)
+      Trace.pop_front();
+  }
+
+  return d;
+}
+
+std::vector<AdaptiveDecision> AdaptiveController::GetTrace() const
+{
+  return std::vector<AdaptiveDecision>(Trace.begin(), Trace.end());
+}
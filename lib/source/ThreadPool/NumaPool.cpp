@@ -0,0 +1,66 @@
+#include <cassert>
+
+#include <Syncme/ThreadPool/NumaPool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+NumaPool::NumaPool(AFFINITY_MODE mode)
+{
+  uint32_t count = GetNumaNodeCount();
+
+  for (uint32_t node = 0; node < count; ++node)
+  {
+    CpuSet cpus = GetNumaNodeCpus(node);
+
+    // Pool of a node without CPUs is not restricted. It exists to keep
+    // indices of pools equal to node ids
+    auto pool = std::make_unique<Pool>();
+    if (!cpus.empty())
+    {
+      pool->SetAffinity(cpus, mode);
+
+      if (mode == AFFINITY_MODE::PER_CORE)
+        pool->SetMaxThreads(cpus.size());
+    }
+
+    Nodes.push_back(std::move(pool));
+  }
+}
+
+NumaPool::~NumaPool()
+{
+  Stop();
+}
+
+void NumaPool::Stop()
+{
+  for (auto& pool : Nodes)
+    pool->Stop();
+}
+
+size_t NumaPool::GetNodeCount() const
+{
+  return Nodes.size();
+}
+
+Pool& NumaPool::GetNode(size_t node)
+{
+  assert(!Nodes.empty());
+  return *Nodes[node % Nodes.size()];
+}
+
+Pool& NumaPool::GetLocalNode()
+{
+  return GetNode(GetCurrentNumaNode());
+}
+
+HEvent NumaPool::Run(TCallback cb, uint64_t* pid)
+{
+  return GetLocalNode().Run(cb, pid);
+}
+
+HEvent NumaPool::Run(size_t node, TCallback cb, uint64_t* pid)
+{
+  return GetNode(node).Run(cb, pid);
+}
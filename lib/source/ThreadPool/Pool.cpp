@@ -4,6 +4,7 @@
 #include <sched.h>
 #endif
 
+#include <algorithm>
 #include <cassert>
 
 #include <Syncme/Logger/Log.h>
@@ -11,13 +12,18 @@
 #include <Syncme/Sleep.h>
 #include <Syncme/ThreadPool/Counter.h>
 #include <Syncme/ThreadPool/Pool.h>
+#include <Syncme/TickCount.h>
 
 #define LOCK_GUARD() \
   std::lock_guard<std::mutex> guard(Lock); \
   Owner = GetCurrentThreadId()
 
-#define SET_TIMER() \
-  SetWaitableTimer(Timer, 4 * MaxIdleTime / 3, 0, nullptr)
+// Idle workers over MaxUnusedThreads (and MinThreads) wake up periodically 
+// to stop expired workers. Others sleep till they are invoked
+#define IDLE_TIMEOUT() \
+  (Unused.Size() > MaxUnusedThreads && All.Size() > MinThreads \
+    ? uint32_t(std::max<long>(1, 4 * MaxIdleTime / 3)) \
+    : FOREVER)
 
 using namespace Syncme::ThreadPool;
 
@@ -26,6 +32,8 @@ static const size_t MAX_THREADS = 100;
 static const long MAX_IDLE_TIME = 3000; // 3 sec
 static const size_t COMPACT_PERCENT = 80;
 static const size_t COMPACT_STEP = 10;
+static const size_t QUEUE_CAPACITY = 10000;
+static const size_t KEYS_PRUNE_AT = 1024;
 
 namespace Syncme::ThreadPool
 {
@@ -37,6 +45,8 @@ namespace Syncme::ThreadPool
   std::atomic<uint64_t> CreateInvoke;
   std::atomic<uint64_t> DirectInvoke;
   std::atomic<uint64_t> SlowInvoke;
+  std::atomic<uint64_t> AffineInvoke;
+  std::atomic<uint64_t> AffineSteal;
   std::atomic<uint64_t> Errors;
 
   std::atomic<uint64_t> LockedInRunCreateWorker;
@@ -62,15 +72,37 @@ uint64_t Syncme::ThreadPool::GetLockedInCompact() { return LockedInCompact; }
 uint64_t Syncme::ThreadPool::GetDirectInvoke() { return DirectInvoke; }
 uint64_t Syncme::ThreadPool::GetSlowInvoke() { return SlowInvoke; }
 uint64_t Syncme::ThreadPool::GetCreateInvoke() { return CreateInvoke; }
+uint64_t Syncme::ThreadPool::GetAffineInvoke() { return AffineInvoke; }
+uint64_t Syncme::ThreadPool::GetAffineSteal() { return AffineSteal; }
 
 Pool::Pool()
   : MaxUnusedThreads(MAX_UNUSED_THREADS)
   , MaxThreads(MAX_THREADS)
+  , MinThreads(0)
   , MaxIdleTime(MAX_IDLE_TIME)
+  , StackSize(0)
   , Mode(OVERFLOW_MODE::WAIT)
-  , Timer(CreateAutoResetTimer())
+  , QueueCapacity(QUEUE_CAPACITY)
+  , HighWater(QUEUE_CAPACITY)
+  , BackpressureOn(false)
+  , CompactPercent(COMPACT_PERCENT)
+  , CompactStep(COMPACT_STEP)
+  , ThreadLimit(MAX_THREADS)
+  , Adaptive(false)
+  , AdaptInterval(0)
+  , LastSample(0)
+  , NextSample(0)
+  , Completed(0)
+  , PeakBusy(0)
+  , AffinityMode(AFFINITY_MODE::SHARED)
+  , Reserved{}
+  , Lanes{}
   , Owner(0)
   , Stopping(false)
+  , Busy(0)
+  , PendingTasks(0)
+  , QueueSeq(0)
+  , KeysPruneAt(KEYS_PRUNE_AT)
 {
   FreeEvent = CreateSynchronizationEvent();
   StopEvent = CreateNotificationEvent();
@@ -91,6 +123,9 @@ void Pool::SetMaxThreads(size_t n)
 {
   assert(n > 0);
   MaxThreads = n;
+
+  if (!Adaptive)
+    ThreadLimit = n;
 }
 
 size_t Pool::GetMaxUnusedThreads() const
@@ -113,6 +148,51 @@ void Pool::SetMaxIdleTime(long t)
   MaxIdleTime = t;
 }
 
+size_t Pool::GetMinThreads() const
+{
+  return MinThreads;
+}
+
+void Pool::SetMinThreads(size_t n)
+{
+  MinThreads = n;
+  Prespawn();
+}
+
+size_t Pool::GetStackSize() const
+{
+  return StackSize;
+}
+
+void Pool::SetStackSize(size_t size)
+{
+  StackSize = size;
+}
+
+void Pool::Prespawn()
+{
+  TimePoint t0;
+  size_t count = 0;
+
+  if (true)
+  {
+    LOCK_GUARD();
+
+    size_t n = std::min<size_t>(MinThreads, ThreadLimit);
+    if (!Stopping && All.Size() < n)
+      count = n - All.Size();
+  }
+
+  // Workers are not waited for, so threads start in parallel. They 
+  // are added to Unused by CB_OnFree()
+  for (size_t i = 0; i < count; ++i)
+  {
+    HEvent h;
+    if (CreateWorker(t0, TCallback(), nullptr, h) == nullptr)
+      break;
+  }
+}
+
 OVERFLOW_MODE Pool::GetOverflowMode() const
 {
   return Mode;
@@ -123,11 +203,219 @@ void Pool::SetOverflowMode(OVERFLOW_MODE mode)
   Mode = mode;
 }
 
+void Pool::SetQueueLimits(
+  size_t capacity
+  , size_t highWater
+  , TBackpressure cb
+)
+{
+  QueueCapacity = capacity;
+  HighWater = std::max<size_t>(1, std::min(highWater, capacity));
+  Backpressure = cb;
+  BackpressureOn = false;
+}
+
+size_t Pool::GetPendingTasks() const
+{
+  return PendingTasks;
+}
+
+void Pool::CheckBackpressure()
+{
+  if (!Backpressure)
+    return;
+
+  size_t n = PendingTasks;
+  bool on = BackpressureOn;
+
+  if (on == false && n >= HighWater)
+  {
+    if (BackpressureOn.compare_exchange_strong(on, true))
+      Backpressure(true, n);
+  }
+  else if (on && n <= HighWater / 2)
+  {
+    if (BackpressureOn.compare_exchange_strong(on, false))
+      Backpressure(false, n);
+  }
+}
+
 void Pool::SetCompact(SCompact compact)
 {
   Compact = compact;
 }
 
+size_t Pool::GetReservedThreads(PRIORITY lane) const
+{
+  return Reserved[size_t(lane)];
+}
+
+void Pool::SetReservedThreads(PRIORITY lane, size_t n)
+{
+  Reserved[size_t(lane)] = n;
+}
+
+LaneStats Pool::GetLaneStats(PRIORITY lane) const
+{
+  auto& c = Lanes[size_t(lane)];
+
+  LaneStats stats{};
+  stats.Submitted = c.Submitted;
+  stats.Started = c.Started;
+  stats.Expired = c.Expired;
+  stats.Demoted = c.Demoted;
+  stats.TotalDelay = c.TotalDelay;
+  stats.MaxDelay = c.MaxDelay;
+  return stats;
+}
+
+MetricsSnapshot Pool::GetMetrics(bool reset)
+{
+  return Metrics.Snapshot(reset);
+}
+
+MetricsSnapshot Pool::GetTagMetrics(const std::string& tag, bool reset)
+{
+  std::lock_guard guard(TagLock);
+
+  auto it = Tags.find(tag);
+  if (it == Tags.end())
+    return MetricsSnapshot();
+
+  return it->second->Snapshot(reset);
+}
+
+std::vector<std::string> Pool::GetTags()
+{
+  std::lock_guard guard(TagLock);
+
+  std::vector<std::string> tags;
+  for (auto& t : Tags)
+    tags.push_back(t.first);
+
+  return tags;
+}
+
+TaskMetrics* Pool::FindTagMetrics(const std::string& tag)
+{
+  std::lock_guard guard(TagLock);
+
+  auto& metrics = Tags[tag];
+  if (metrics == nullptr)
+    metrics = std::make_unique<TaskMetrics>();
+
+  return metrics.get();
+}
+
+void Pool::SetAffinity(const CpuSet& cpus, AFFINITY_MODE mode)
+{
+  LOCK_GUARD();
+
+  Affinity = cpus;
+  AffinityMode = mode;
+
+  // Workers bound to the previous set are not counted any more
+  CpuLoad.assign(cpus.size(), 0);
+}
+
+Syncme::CpuSet Pool::GetAffinity() const
+{
+  return Affinity;
+}
+
+AFFINITY_MODE Pool::GetAffinityMode() const
+{
+  return AffinityMode;
+}
+
+void Pool::SetCompactThreshold(size_t percent, size_t step)
+{
+  assert(percent <= 100 && step <= percent);
+
+  CompactPercent = percent;
+  CompactStep = step;
+}
+
+void Pool::SetAdaptive(const AdaptiveConfig& config)
+{
+  std::lock_guard guard(AdaptLock);
+
+  Controller = AdaptiveController(config);
+  AdaptInterval = std::max<uint32_t>(1, config.Interval);
+
+  LastSample = GetTimeInMillisec();
+  NextSample = LastSample + AdaptInterval;
+  Completed = 0;
+  PeakBusy = Busy.load();
+  AdaptDelay.Reset();
+
+  Adaptive = config.Enabled;
+  ThreadLimit = config.Enabled ? Controller.GetLimit() : MaxThreads;
+
+  // Waiting callers have to check the new limit
+  SetEvent(FreeEvent);
+}
+
+AdaptiveConfig Pool::GetAdaptive()
+{
+  std::lock_guard guard(AdaptLock);
+  return Controller.GetConfig();
+}
+
+std::vector<AdaptiveDecision> Pool::GetAdaptiveTrace()
+{
+  std::lock_guard guard(AdaptLock);
+  return Controller.GetTrace();
+}
+
+size_t Pool::GetThreadLimit() const
+{
+  return ThreadLimit;
+}
+
+void Pool::Adapt()
+{
+  if (!Adaptive)
+    return;
+
+  uint64_t now = GetTimeInMillisec();
+  if (now < NextSample)
+    return;
+
+  // Only one thread makes the decision. Others continue without waiting
+  std::unique_lock guard(AdaptLock, std::try_to_lock);
+  if (!guard.owns_lock() || !Adaptive || now < NextSample)
+    return;
+
+  AdaptiveSample sample{};
+  sample.Time = now;
+  sample.Interval = now - LastSample;
+  sample.Completed = Completed.exchange(0);
+  sample.QueueDelay = AdaptDelay.SnapshotAndReset().Percentile(90);
+  sample.PeakBusy = PeakBusy.exchange(Busy);
+
+  LastSample = now;
+  NextSample = now + AdaptInterval;
+
+  AdaptiveDecision d = Controller.Update(sample);
+  ThreadLimit = d.Limit;
+
+  if (d.Change > 0)
+    SetEvent(FreeEvent);
+
+  if (d.Change < 0)
+  {
+    LOCK_GUARD();
+
+    while (!Stopping && All.Size() > std::max<size_t>(ThreadLimit, MinThreads) && !Unused.Empty())
+      Locked_StopWorker(Unused.Back());
+  }
+
+  auto& onDecision = Controller.GetConfig().OnDecision;
+  if (onDecision)
+    onDecision(d);
+}
+
 void Pool::SetStopping()
 {
   LOCK_GUARD();
@@ -138,60 +426,141 @@ void Pool::SetStopping()
 void Pool::Stop()
 {
   SetStopping();
+  DropQueued();
+  DropKeyed();
 
-  for (auto& e : All)
+  for (Worker* e = All.Front(); e; e = All.Next(e))
   {
     e->Stop();
     ThreadsStopped++;
   }
 
   LOCK_GUARD();
-  assert(All.size() == Unused.size());
+  assert(All.Size() == Unused.Size());
 
-  Unused.clear();
-  ThreadsUnused = 0;
+  Unused.Clear();
+  All.Clear();
+  Locked_UpdateCounters();
 
-  All.clear();
-  ThreadsTotal = 0;
+  CpuLoad.assign(Affinity.size(), 0);
 }
 
-void Pool::StopUnused()
+// Tasks left in the queue are not executed. Their handles are signalled
+void Pool::DropQueued()
 {
-  LOCK_GUARD();
+  TaskList dropped;
 
-  for (auto& e : Unused)
-    e->SetExpireTimer(0);
+  if (true)
+  {
+    std::lock_guard guard(TaskLock);
 
-  Locked_StopExpired(nullptr);
+    for (auto& tasks : Tasks)
+    {
+      for (auto& task : tasks)
+      {
+        task->Queued = false;
+        task->Expired = true;
+      }
+
+      dropped.splice(dropped.end(), tasks);
+    }
+
+    PendingTasks = 0;
+  }
+
+  for (auto& task : dropped)
+  {
+    if (task->ThreadHandle)
+      SetEvent(task->ThreadHandle);
+
+    if (task->OnDrop)
+      task->OnDrop();
+
+    Errors++;
+  }
+
+  CheckBackpressure();
 }
 
-WorkerPtr Pool::PopUnused(size_t& allCount)
+void Pool::StopUnused()
 {
   LOCK_GUARD();
 
-  allCount = All.size();
+  while (!Unused.Empty())
+    Locked_StopWorker(Unused.Back());
+}
+
+WorkerPtr Pool::PopUnused(PRIORITY lane, bool& full)
+{
+  LOCK_GUARD();
 
-  if (Unused.empty())
+  // Rest of workers is reserved for more urgent lanes
+  full = All.Size() - Unused.Size() >= GetLimit(lane);
+  if (full)
     return WorkerPtr();
 
-  WorkerPtr t = Unused.front();
-  Unused.pop_front();
-  
-  ThreadsUnused = Unused.size();
+  WorkerPtr t = Unused.PopFront();
+  if (t == nullptr)
+  {
+    full = All.Size() >= ThreadLimit;
+    return WorkerPtr();
+  }
 
-  t->CancelExpireTimer();
+  Locked_UpdateCounters();
   Locked_StopExpired(nullptr);
   
   return t;
 }
 
-void Pool::Push(WorkerList& list, WorkerPtr t)
+size_t Pool::PopUnused(size_t count, std::vector<WorkerPtr>& idle)
+{
+  LOCK_GUARD();
+
+  // Batches are submitted to NORMAL lane
+  size_t limit = GetLimit(PRIORITY::NORMAL);
+  size_t busy = All.Size() - Unused.Size();
+  if (busy >= limit)
+    return 0;
+
+  count = std::min(count, limit - busy);
+
+  while (idle.size() < count && !Unused.Empty())
+    idle.push_back(Unused.PopFront());
+
+  Locked_UpdateCounters();
+
+  if (!idle.empty())
+    Locked_StopExpired(nullptr);
+
+  // Number of workers which can be created for the rest of tasks
+  size_t rest = count - idle.size();
+  size_t allCount = All.Size();
+
+  size_t threadLimit = ThreadLimit;
+  if (allCount >= threadLimit)
+    return 0;
+
+  return std::min(rest, threadLimit - allCount);
+}
+
+void Pool::PushAll(WorkerPtr t)
 {
   LOCK_GUARD();
-  list.push_back(t);
 
-  ThreadsUnused = Unused.size();
-  ThreadsTotal = All.size();
+  Locked_Bind(t.get());
+  All.PushBack(t);
+
+  Locked_UpdateCounters();
+}
+
+void Pool::PushUnused(WorkerPtr t)
+{
+  LOCK_GUARD();
+
+  t->SetIdleSince(GetTimeInMillisec());
+  Unused.PushFront(t);
+
+  Locked_UpdateCounters();
 }
 
 WorkerPtr Pool::CreateWorker(
@@ -203,8 +572,9 @@ WorkerPtr Pool::CreateWorker(
 {
   TOnIdle notifyIdle = std::bind(&Pool::CB_OnFree, this, std::placeholders::_1);
   TOnTimer onTimer = std::bind(&Pool::CB_OnTimer, this, std::placeholders::_1);
-  WorkerPtr t = std::make_shared<Worker>(Timer, notifyIdle, onTimer);
-  Push(All, t);
+  WorkerPtr t = std::make_shared<Worker>(notifyIdle, onTimer);
+  t->SetStackSize(StackSize);
+  PushAll(t);
 
   thread = t->Start(cb, pid);
   if (!thread)
@@ -216,14 +586,9 @@ WorkerPtr Pool::CreateWorker(
 
     LOCK_GUARD();
 
-    auto ita = std::find_if(
-      All.begin()
-      , All.end()
-      , [t](WorkerPtr e) { return e.get() == t.get(); }
-    );
-    
-    if (ita != All.end())
-      All.erase(ita);
+    Locked_Unbind(t.get());
+    All.Remove(t.get());
+    Locked_UpdateCounters();
 
     return nullptr;
   }
@@ -244,12 +609,13 @@ void Pool::DoCompact()
     {
       LOCK_GUARD();
 
-      size_t inuse = All.size() - Unused.size();
-      size_t limit = (100 * inuse) / MaxThreads;
-      if (limit >= COMPACT_PERCENT)
+      size_t threadLimit = ThreadLimit;
+      size_t inuse = All.Size() - Unused.Size();
+      size_t limit = (100 * inuse) / threadLimit;
+      if (limit >= CompactPercent)
       {
-        size_t desired = (COMPACT_PERCENT - COMPACT_STEP) * MaxThreads / 100;
-        try2free = inuse - desired;
+        size_t desired = (CompactPercent - CompactStep) * threadLimit / 100;
+        try2free = inuse > desired ? inuse - desired : 0;
       }
     }
 
@@ -260,14 +626,93 @@ void Pool::DoCompact()
   LockedInCompact += t0.ElapsedSince();
 }
 
-TaskPtr Pool::QueueTask(TCallback cb)
+size_t Pool::GetLimit(PRIORITY lane) const
+{
+  size_t reserved = 0;
+  for (size_t i = 0; i < size_t(lane); ++i)
+    reserved += Reserved[i];
+
+  size_t threadLimit = ThreadLimit;
+  if (reserved >= threadLimit)
+    return 1;
+
+  return threadLimit - reserved;
+}
+
+uint32_t Pool::GetWaitTime(TaskPtr task)
+{
+  std::lock_guard guard(TaskLock);
+
+  if (task->Deadline == 0)
+    return FOREVER;
+
+  uint64_t now = GetTimeInMicrosec();
+  if (now >= task->Deadline)
+    return 0;
+
+  return uint32_t((task->Deadline - now + 999) / 1000);
+}
+
+void Pool::TaskStarted(const TaskPtr& task)
+{
+  auto& lane = Lanes[size_t(task->Lane)];
+
+  uint64_t delay = GetTimeInMicrosec() - task->Submitted;
+  Metrics.QueueDelay.Record(delay);
+
+  if (Adaptive)
+    AdaptDelay.Record(delay);
+
+  if (task->Metrics)
+    task->Metrics->QueueDelay.Record(delay);
+
+  lane.Started++;
+  lane.TotalDelay += delay;
+
+  uint64_t max = lane.MaxDelay;
+  while (delay > max && !lane.MaxDelay.compare_exchange_weak(max, delay));
+}
+
+TaskPtr Pool::QueueTask(TCallback cb, const RunOptions& options)
 {
   TaskPtr task = std::make_shared<Task>();
   task->Callback = cb;
+  task->Lane = options.Priority;
+  task->Priority = options.Priority;
+  task->Submitted = GetTimeInMicrosec();
+  task->Policy = options.Policy;
+  task->OnDrop = options.OnDrop;
+
+  if (options.Deadline)
+    task->Deadline = task->Submitted + uint64_t(options.Deadline) * 1000;
+
+  if (!options.Tag.empty())
+  {
+    TaskMetrics* metrics = FindTagMetrics(options.Tag);
+    task->Metrics = metrics;
+
+    task->Callback = [metrics, cb]()
+    {
+      uint64_t t0 = GetTimeInMicrosec();
+      cb();
+      metrics->RunTime.Record(GetTimeInMicrosec() - t0);
+    };
+  }
+
+  Lanes[size_t(task->Lane)].Submitted++;
+
+  auto& tasks = Tasks[size_t(task->Lane)];
+
+  // Run() returns the handle before a worker is found
+  if (Mode == OVERFLOW_MODE::QUEUE)
+    task->ThreadHandle = CreateNotificationEvent();
 
   std::lock_guard guard(TaskLock);
-  Tasks.push_back(task);
+  task->Position = tasks.insert(tasks.end(), task);
+  task->Queued = true;
 
+  PendingTasks++;
+  QueueSeq++;
   return task;
 }
 
@@ -275,84 +720,272 @@ bool Pool::DequeueTask(TaskPtr task)
 {
   std::lock_guard guard(TaskLock);
 
-  auto it = std::find_if(
-    Tasks.begin()
-    , Tasks.end()
-    , [task](TaskPtr t) { return task.get() == t.get(); }
-  );
+  if (task->Queued == false)
+    return false;
+
+  Tasks[size_t(task->Priority.load())].erase(task->Position);
+  task->Queued = false;
+
+  PendingTasks--;
+  return true;
+}
+
+// Puts a dequeued task back to the head of its lane
+void Pool::RequeueTask(TaskPtr task)
+{
+  std::lock_guard guard(TaskLock);
+
+  auto& tasks = Tasks[size_t(task->Priority.load())];
+  task->Position = tasks.insert(tasks.begin(), task);
+  task->Queued = true;
+
+  PendingTasks++;
+  QueueSeq++;
+}
+
+// Returns false if the task was already taken by a worker
+bool Pool::ExpireTask(TaskPtr task)
+{
+  std::lock_guard guard(TaskLock);
+
+  if (task->Queued == false)
+    return false;
 
-  if (it != Tasks.end())
+  if (task->Policy == DEADLINE_POLICY::DEMOTE)
   {
-    Tasks.erase(it);
+    Locked_Demote(task);
     return true;
   }
 
-  return false;
+  Tasks[size_t(task->Priority.load())].erase(task->Position);
+  task->Queued = false;
+  task->Expired = true;
+
+  PendingTasks--;
+  Lanes[size_t(task->Lane)].Expired++;
+  return true;
 }
 
-bool Pool::Run2(
-  uint64_t* pid
-  , HEvent& h
-  , TaskPtr task
-  , TimePoint& t0
-)
+void Pool::Locked_Demote(TaskPtr task)
 {
-  if (pid)
-    *pid = 0;
+  auto& from = Tasks[size_t(task->Priority.load())];
+  auto& to = Tasks[size_t(PRIORITY::LOW)];
 
-  WorkerPtr t;
-  EventArray ev(StopEvent, FreeEvent);
+  // Iterator stays valid
+  to.splice(to.end(), from, task->Position);
 
-  DoCompact();
+  task->Priority = PRIORITY::LOW;
+  task->Deadline = 0;
 
-  for (int loop = 0; !Stopping; ++loop)
+  Lanes[size_t(task->Lane)].Demoted++;
+}
+
+// Called by a worker which completed its task. Busy includes the worker.
+// Dropped tasks are moved to expired, their OnDrop is called by the
+// caller after TaskLock is released
+TaskPtr Pool::Locked_PopTask(TaskList& expired)
+{
+  uint64_t now = 0;
+  size_t busy = Busy;
+
+  for (size_t lane = 0; lane < PRIORITY_COUNT; ++lane)
   {
-    size_t allSize{};
-    t = PopUnused(allSize);
+    auto& tasks = Tasks[lane];
 
-    if (t == nullptr)
+    while (!tasks.empty())
     {
-      if (allSize >= MaxThreads)
+      TaskPtr task = tasks.front();
+
+      if (task->Deadline)
       {
-        if (Mode == OVERFLOW_MODE::FAIL)
-        {
-          Errors++;
-          return true;
-        }
+        if (now == 0)
+          now = GetTimeInMicrosec();
 
-        auto rc = WaitForMultipleObjects(ev, false);
-        if (rc == WAIT_RESULT::OBJECT_0)
+        if (now >= task->Deadline)
         {
-          auto e = t0.ElapsedSince();
-
-          if (e > 200)
+          if (task->Policy == DEADLINE_POLICY::DEMOTE)
           {
-            LogW("loops=%i, spent=%lli, total=%lli, threads=%lli", loop, e, (int64_t)LockedInRun, allSize);
+            Locked_Demote(task);
+            continue;
           }
 
-          return true;
-        }
+          // Run() returns null handle for this task. If Run() has 
+          // already returned (OVERFLOW_MODE::QUEUE), the handle is signalled
+          tasks.pop_front();
+          task->Queued = false;
+          task->Expired = true;
 
-        continue;
+          if (task->ThreadHandle)
+            SetEvent(task->ThreadHandle);
+
+          if (task->OnDrop)
+            expired.push_back(task);
+
+          PendingTasks--;
+          Lanes[size_t(task->Lane)].Expired++;
+          continue;
+        }
       }
 
-      if (DequeueTask(task) == false)
-        return false;
+      // Rest of workers is reserved for more urgent lanes
+      if (busy > GetLimit(PRIORITY(lane)))
+        break;
 
-      task->Worker = CreateWorker(t0, task->Callback, pid, task->ThreadHandle);
-      CreateInvoke++;
-      return true;
-    }
+      tasks.pop_front();
+      task->Queued = false;
 
-    break;
+      PendingTasks--;
+      return task;
+    }
   }
 
+  return TaskPtr();
+}
+
+void Pool::DequeueTasks(
+  TaskList& pending
+  , size_t count
+  , std::vector<TaskPtr>& claimed
+)
+{
+  std::lock_guard guard(TaskLock);
+
+  for (auto it = pending.begin(); it != pending.end();)
+  {
+    TaskPtr task = *it;
+
+    // Task was already taken by a worker in CB_OnFree()
+    if (task->Queued == false)
+    {
+      it = pending.erase(it);
+      continue;
+    }
+
+    if (claimed.size() == count)
+      break;
+
+    Tasks[size_t(task->Priority.load())].erase(task->Position);
+    task->Queued = false;
+    PendingTasks--;
+
+    claimed.push_back(task);
+    it = pending.erase(it);
+  }
+}
+
+bool Pool::Run2(
+  uint64_t* pid
+  , HEvent& h
+  , TaskPtr task
+  , TimePoint& t0
+  , bool& deferred
+)
+{
+  if (pid)
+    *pid = 0;
+
+  deferred = false;
+
+  WorkerPtr t;
+  EventArray ev(StopEvent, FreeEvent);
+
+  DoCompact();
+
+  for (int loop = 0; !Stopping; ++loop)
+  {
+    Adapt();
+
+    bool full{};
+    t = PopUnused(task->Priority, full);
+
+    if (t == nullptr)
+    {
+      if (full)
+      {
+        if (Mode == OVERFLOW_MODE::FAIL)
+        {
+          // The task has to be removed from the queue. Otherwise it 
+          // would be executed later by a worker in CB_OnFree()
+          if (DequeueTask(task) == false)
+            return false;
+
+          Errors++;
+          return true;
+        }
+
+        if (Mode == OVERFLOW_MODE::QUEUE)
+        {
+          // The task stays in the queue. A worker takes it in CB_OnFree()
+          if (PendingTasks <= QueueCapacity)
+          {
+            deferred = true;
+            return false;
+          }
+
+          if (DequeueTask(task) == false)
+            return false;
+
+          // Run() returns null handle
+          task->ThreadHandle = HEvent();
+          Errors++;
+          return true;
+        }
+
+        // Adaptive controller can increase the limit in the meantime
+        uint32_t ms = GetWaitTime(task);
+        if (Adaptive)
+          ms = std::min(ms, AdaptInterval);
+
+        auto rc = WaitForMultipleObjects(ev, false, ms);
+        if (rc == WAIT_RESULT::OBJECT_0)
+        {
+          auto e = t0.ElapsedSince();
+
+          if (e > 200)
+          {
+            LogW("loops=%i, spent=%lli, total=%lli, busy=%lli", loop, e, (int64_t)LockedInRun, (int64_t)Busy);
+          }
+
+          return DequeueTask(task);
+        }
+
+        if (rc == WAIT_RESULT::TIMEOUT && GetWaitTime(task) == 0)
+        {
+          // Deadline is reached. The task is either dropped or demoted
+          if (ExpireTask(task) == false)
+            return false;
+
+          if (task->Expired)
+            return true;
+        }
+
+        continue;
+      }
+
+      if (DequeueTask(task) == false)
+        return false;
+
+      TaskStarted(task);
+      task->Worker = CreateWorker(t0, task->Callback, pid, task->ThreadHandle);
+      CreateInvoke++;
+      return true;
+    }
+
+    break;
+  }
+
+  // The pool is stopping
+  if (t == nullptr)
+    return DequeueTask(task);
+
   if (DequeueTask(task) == false)
   {
-    Push(Unused, t);
+    PushUnused(t);
     return false;
   }
 
+  TaskStarted(task);
+
   uint64_t id{};
   task->ThreadHandle = t->Invoke(task->Callback, id);
   if (task->ThreadHandle)
@@ -364,27 +997,50 @@ bool Pool::Run2(
     return true;
   }
 
-  Push(Unused, t);
+  PushUnused(t);
   Errors++;
   return true;
 }
 
 HEvent Pool::Run(TCallback cb, uint64_t* pid)
+{
+  return Run(cb, RunOptions(), pid);
+}
+
+HEvent Pool::Run(TCallback cb, const RunOptions& options, uint64_t* pid)
 {
   TimePoint t0;
-  TaskPtr task = QueueTask(cb);
+  TaskPtr task = QueueTask(cb, options);
 
   if (pid)
     *pid = 0;
 
-  bool dequeued = Run2(pid, task->ThreadHandle, task, t0);
+  bool deferred{};
+  bool dequeued = Run2(pid, task->ThreadHandle, task, t0, deferred);
 
   TimePoint t1;
   LockedInRunInvoke += t1.ElapsedSince();
   LockedInRun += t0.ElapsedSince();
 
+  uint64_t overhead = GetTimeInMicrosec() - task->Submitted;
+  Metrics.RunOverhead.Record(overhead);
+
+  if (task->Metrics)
+    task->Metrics->RunOverhead.Record(overhead);
+
+  // Handle was created by QueueTask(). Worker is not known yet
+  if (deferred)
+  {
+    CheckBackpressure();
+    return task->ThreadHandle;
+  }
+
   if (dequeued == false)
   {
+    // Deadline was reached while the task was waiting in the queue
+    if (task->Expired)
+      return HEvent();
+
     if (pid != nullptr)
       *pid = task->Worker->GetTid();
 
@@ -395,29 +1051,454 @@ HEvent Pool::Run(TCallback cb, uint64_t* pid)
   return task->ThreadHandle;
 }
 
-void Pool::Locked_Find(Worker* p, bool& all, bool& unused)
+HEvent Pool::Run(uint64_t key, TCallback cb)
 {
-  WorkerPtr t = p->Get();
+  HEvent h = CreateNotificationEvent();
+  WorkerPtr home;
 
-  all = false;
-  for (auto& e : All)
+  if (true)
   {
-    if (e.get() != p)
-      continue;
-    
-    all = true;
-    break;
+    std::lock_guard guard(KeyLock);
+
+    if (Keys.size() >= KeysPruneAt)
+      Locked_PruneKeys();
+
+    KeyState& state = Keys[key];
+    state.Pending.push_back(KeyedItem{cb, h});
+
+    // Drain callback of the key is running or scheduled. It takes the task
+    if (state.Active)
+      return h;
+
+    state.Active = true;
+    home = state.Home.lock();
   }
 
-  unused = false;
-  for (auto& e : Unused)
+  if (DispatchKey(key, home))
+    return h;
+
+  // Tasks which were added while the drain callback was being scheduled
+  // are dropped too
+  std::deque<KeyedItem> dropped;
+
+  if (true)
   {
-    if (e.get() != p)
-      continue;
+    std::lock_guard guard(KeyLock);
 
-    unused = true;
-    break;
+    KeyState& state = Keys[key];
+    dropped.swap(state.Pending);
+    state.Active = false;
+  }
+
+  for (auto& item : dropped)
+  {
+    if (item.Completed != h)
+      SetEvent(item.Completed);
+
+    Errors++;
+  }
+
+  return HEvent();
+}
+
+void Pool::ForgetKey(uint64_t key)
+{
+  std::lock_guard guard(KeyLock);
+
+  auto it = Keys.find(key);
+  if (it != Keys.end() && it->second.Active == false)
+    Keys.erase(it);
+}
+
+WorkerPtr Pool::TakeUnused(Worker* p)
+{
+  LOCK_GUARD();
+
+  if (Stopping || !Unused.Contains(p))
+    return WorkerPtr();
+
+  if (All.Size() - Unused.Size() >= GetLimit(PRIORITY::NORMAL))
+    return WorkerPtr();
+
+  WorkerPtr t = Unused.Remove(p);
+  Locked_UpdateCounters();
+
+  return t;
+}
+
+bool Pool::DispatchKey(uint64_t key, WorkerPtr home)
+{
+  TCallback drain = [this, key]() { DrainKey(key); };
+
+  if (home)
+  {
+    WorkerPtr t = TakeUnused(home.get());
+    if (t)
+    {
+      uint64_t id{};
+      if (t->Invoke(drain, id))
+      {
+        AffineInvoke++;
+        return true;
+      }
+
+      PushUnused(t);
+    }
+  }
+
+  if (Run(drain) == nullptr)
+    return false;
+
+  if (home)
+    AffineSteal++;
+
+  return true;
+}
+
+void Pool::DrainKey(uint64_t key)
+{
+  Worker* self = Worker::GetCurrent();
+
+  for (;;)
+  {
+    KeyedItem item;
+
+    if (true)
+    {
+      std::lock_guard guard(KeyLock);
+
+      // ForgetKey() does not erase active keys
+      KeyState& state = Keys[key];
+      if (state.Pending.empty())
+      {
+        state.Active = false;
+
+        if (self)
+          state.Home = self->weak_from_this();
+
+        return;
+      }
+
+      item = std::move(state.Pending.front());
+      state.Pending.pop_front();
+    }
+
+    try
+    {
+      item.Callback();
+    }
+    catch (const std::exception& e)
+    {
+      LogE("Keyed task threw exception: %s", e.what());
+    }
+    catch (...)
+    {
+      LogE("Keyed task threw unknown exception");
+    }
+
+    item.Callback = TCallback();
+    SetEvent(item.Completed);
+  }
+}
+
+void Pool::DropKeyed()
+{
+  std::vector<KeyedItem> dropped;
+
+  if (true)
+  {
+    std::lock_guard guard(KeyLock);
+
+    for (auto& [key, state] : Keys)
+    {
+      for (auto& item : state.Pending)
+        dropped.push_back(std::move(item));
+
+      state.Pending.clear();
+    }
+  }
+
+  for (auto& item : dropped)
+  {
+    SetEvent(item.Completed);
+    Errors++;
+  }
+}
+
+// Removes idle keys whose home worker was stopped
+void Pool::Locked_PruneKeys()
+{
+  for (auto it = Keys.begin(); it != Keys.end();)
+  {
+    if (it->second.Active == false && it->second.Home.expired())
+      it = Keys.erase(it);
+    else
+      ++it;
   }
+
+  KeysPruneAt = std::max(KEYS_PRUNE_AT, 2 * Keys.size());
+}
+
+namespace
+{
+  struct BatchState
+  {
+    std::atomic<size_t> Remaining;
+    HEvent Completed;
+
+    BatchState(size_t count)
+      : Remaining(count)
+      , Completed(Syncme::CreateNotificationEvent())
+    {
+    }
+
+    void Release(size_t count = 1)
+    {
+      if (Remaining.fetch_sub(count) == count)
+        Syncme::SetEvent(Completed);
+    }
+  };
+
+  typedef std::shared_ptr<BatchState> BatchStatePtr;
+
+  struct BatchRelease
+  {
+    BatchState* State;
+
+    ~BatchRelease()
+    {
+      State->Release();
+    }
+  };
+}
+
+size_t Pool::RunBatch(std::span<const TCallback> batch, HEvent* completion)
+{
+  return RunBatch2(batch, completion, Mode);
+}
+
+// Tasks which can not be dispatched immediately are dropped in 
+// OVERFLOW_MODE::FAIL and left in the queue in OVERFLOW_MODE::QUEUE
+size_t Pool::RunBatch2(
+  std::span<const TCallback> batch
+  , HEvent* completion
+  , OVERFLOW_MODE mode
+)
+{
+  TimePoint t0;
+
+  if (completion)
+    *completion = HEvent();
+
+  if (batch.empty())
+    return 0;
+
+  BatchStatePtr state;
+  if (completion)
+  {
+    state = std::make_shared<BatchState>(batch.size());
+    *completion = state->Completed;
+  }
+
+  uint64_t submitted = GetTimeInMicrosec();
+
+  TaskList pending;
+  for (auto& cb : batch)
+  {
+    TaskPtr task = std::make_shared<Task>();
+    task->Submitted = submitted;
+
+    if (state)
+    {
+      task->Callback = [state, cb]()
+      {
+        BatchRelease release{ state.get() };
+        cb();
+      };
+
+      task->OnDrop = [state]() { state->Release(); };
+    }
+    else
+      task->Callback = cb;
+
+    pending.push_back(task);
+  }
+
+  Lanes[size_t(PRIORITY::NORMAL)].Submitted += batch.size();
+
+  if (true)
+  {
+    auto& tasks = Tasks[size_t(PRIORITY::NORMAL)];
+    std::lock_guard guard(TaskLock);
+
+    for (auto& task : pending)
+    {
+      task->Position = tasks.insert(tasks.end(), task);
+      task->Queued = true;
+    }
+
+    PendingTasks += pending.size();
+    QueueSeq++;
+  }
+
+  DoCompact();
+
+  size_t dropped = 0;
+  EventArray ev(StopEvent, FreeEvent);
+
+  while (!pending.empty())
+  {
+    Adapt();
+
+    std::vector<WorkerPtr> idle;
+    size_t create = 0;
+
+    if (!Stopping)
+      create = PopUnused(pending.size(), idle);
+
+    std::vector<TaskPtr> claimed;
+    size_t available = idle.size() + create;
+
+    if (available == 0)
+    {
+      if (!Stopping && mode == OVERFLOW_MODE::WAIT)
+      {
+        WaitForMultipleObjects(ev, false, Adaptive ? AdaptInterval : FOREVER);
+        continue;
+      }
+
+      if (!Stopping && mode == OVERFLOW_MODE::QUEUE)
+      {
+        // Only tasks above the queue capacity are dropped
+        size_t n = PendingTasks;
+        size_t excess = n > QueueCapacity ? n - QueueCapacity : 0;
+
+        DequeueTasks(pending, std::min(excess, pending.size()), claimed);
+        dropped += claimed.size();
+        Errors += claimed.size();
+        break;
+      }
+
+      // Drop the rest of tasks if the pool is stopping or it is not 
+      // allowed to wait for a free worker
+      DequeueTasks(pending, pending.size(), claimed);
+      dropped += claimed.size();
+      Errors += claimed.size();
+      break;
+    }
+
+    DequeueTasks(pending, available, claimed);
+
+    size_t i = 0;
+    for (; i < claimed.size(); ++i)
+    {
+      TaskPtr& task = claimed[i];
+
+      if (i < idle.size())
+      {
+        uint64_t id{};
+        task->ThreadHandle = idle[i]->Invoke(task->Callback, id);
+
+        if (task->ThreadHandle)
+        {
+          TaskStarted(task);
+          SlowInvoke++;
+          continue;
+        }
+
+        PushUnused(idle[i]);
+
+        // The worker is stopping. The task is taken by the next free
+        // worker: by this loop or in CB_OnFree()
+        RequeueTask(task);
+        pending.push_front(task);
+        continue;
+      }
+      else
+      {
+        TaskStarted(task);
+        WorkerPtr worker = CreateWorker(t0, task->Callback, nullptr, task->ThreadHandle);
+
+        if (worker)
+        {
+          CreateInvoke++;
+          continue;
+        }
+      }
+
+      Errors++;
+      dropped++;
+    }
+
+    // All remaining tasks were taken by workers directly
+    for (; i < idle.size(); ++i)
+      PushUnused(idle[i]);
+  }
+
+  if (state && dropped)
+    state->Release(dropped);
+
+  CheckBackpressure();
+
+  LockedInRun += t0.ElapsedSince();
+  return batch.size() - dropped;
+}
+
+void Pool::Locked_Find(Worker* p, bool& all, bool& unused)
+{
+  all = All.Contains(p);
+  unused = Unused.Contains(p);
+}
+
+void Pool::Locked_UpdateCounters()
+{
+  ThreadsTotal = All.Size();
+  ThreadsUnused = Unused.Size();
+
+  Busy = All.Size() - Unused.Size();
+
+  if (Busy > PeakBusy)
+    PeakBusy = Busy.load();
+}
+
+void Pool::Locked_Bind(Worker* p)
+{
+  if (Affinity.empty())
+    return;
+
+  if (AffinityMode == AFFINITY_MODE::SHARED)
+  {
+    p->SetAffinity(Affinity);
+    return;
+  }
+
+  size_t best = 0;
+  for (size_t i = 1; i < CpuLoad.size(); ++i)
+  {
+    if (CpuLoad[i] < CpuLoad[best])
+      best = i;
+  }
+
+  CpuLoad[best]++;
+  p->SetAffinity(CpuSet{Affinity[best]});
+}
+
+void Pool::Locked_Unbind(Worker* p)
+{
+  if (AffinityMode != AFFINITY_MODE::PER_CORE)
+    return;
+
+  auto& cpus = p->GetAffinity();
+  if (cpus.size() != 1)
+    return;
+
+  auto it = std::find(Affinity.begin(), Affinity.end(), cpus[0]);
+  if (it == Affinity.end())
+    return;
+
+  size_t i = it - Affinity.begin();
+  if (CpuLoad[i])
+    CpuLoad[i]--;
 }
 
 void Pool::CB_OnTimer(Worker* p)
@@ -429,6 +1510,8 @@ void Pool::CB_OnTimer(Worker* p)
     Owner = GetCurrentThreadId();
 
     Locked_StopExpired(p);
+    p->SetIdleTimeout(IDLE_TIMEOUT());
+
     Lock.unlock();
   }
 }
@@ -444,98 +1527,178 @@ static void YieldThread()
 
 TaskPtr Pool::CB_OnFree(Worker* p)
 {
-  if (TaskLock.try_lock())
+  // Prespawned worker has not executed anything yet
+  if (p->GetExecuted())
   {
-    if (Tasks.empty() == false)
+    Metrics.RunTime.Record(p->GetLastRunTime());
+    Completed++;
+  }
+
+  Adapt();
+
+  for (;;)
+  {
+    uint64_t seq{};
+    TaskPtr task;
+    TaskList expired;
+
+    if (true)
     {
-      TaskPtr task = Tasks.front();
-      Tasks.pop_front();
+      std::lock_guard guard(TaskLock);
 
-      task->ThreadHandle = p->Handle();
-      task->Worker = p->shared_from_this();
-      ResetEvent(task->ThreadHandle);
+      seq = QueueSeq;
+      task = Locked_PopTask(expired);
 
+      if (task)
+      {
+        if (task->ThreadHandle == nullptr)
+          task->ThreadHandle = CreateNotificationEvent();
+
+        task->Worker = p->shared_from_this();
+      }
+    }
+
+    for (auto& e : expired)
+      e->OnDrop();
+
+    if (task)
+    {
       DirectInvoke++;
-      TaskLock.unlock();
+      TaskStarted(task);
+      CheckBackpressure();
       return task;
     }
 
-    TaskLock.unlock();
-  }
-
-  LOCK_GUARD();
+    LOCK_GUARD();
 
 #ifdef _DEBUG  
-  bool all{}, unused{};
-  Locked_Find(p, all, unused);
-  assert(all == true && unused == false);
+    bool all{}, unused{};
+    Locked_Find(p, all, unused);
+    assert(all == true && unused == false);
 #endif
 
-  if (Unused.size() + 1 > MaxUnusedThreads)
-  {
-    p->SetExpireTimer(MaxIdleTime);
-    SET_TIMER();
-  }
+    // A task queued after Locked_PopTask() might not see the worker in
+    // Unused. It would stay in the queue till another worker is free
+    if (QueueSeq != seq && !Stopping)
+      continue;
 
-  WorkerPtr t = p->Get();
-  Unused.push_front(t);
-  SetEvent(FreeEvent);
+    p->SetIdleSince(GetTimeInMillisec());
+    Unused.PushFront(p->Get());
+    Locked_UpdateCounters();
 
-  return TaskPtr();
+    p->SetIdleTimeout(IDLE_TIMEOUT());
+    SetEvent(FreeEvent);
+
+    return TaskPtr();
+  }
 }
 
 void Pool::Locked_StopExpired(Worker* caller)
 {
-  CancelWaitableTimer(Timer);
-
-  if (Stopping)
+  if (Stopping || Unused.Size() <= MaxUnusedThreads || All.Size() <= MinThreads)
     return;
 
-  bool setTimer = false;
-  for (bool cont = true; cont;)
+  uint64_t now = GetTimeInMillisec();
+
+  // Unused is a LIFO stack, so workers at its bottom are idle for the
+  // longest time. We stop as soon as we meet a worker which is not expired
+  for (Worker* e = Unused.Back(); e && Unused.Size() > MaxUnusedThreads && All.Size() > MinThreads;)
   {
-    cont = false;
+    if (now - e->GetIdleSince() < (uint64_t)MaxIdleTime)
+      break;
 
-    for (auto it = Unused.begin(); it != Unused.end(); ++it)
-    {
-      WorkerPtr e = *it;
-      if (!e->IsExpired())
-        continue;
+    Worker* prev = Unused.Prev(e);
 
-      if (caller && e.get() == caller)
-      {
-        setTimer = true;
-        continue;
-      }
+    // Worker can not stop itself. It will be stopped next time
+    if (e != caller)
+      Locked_StopWorker(e);
 
-      auto ita = std::find_if(
-        All.begin()
-        , All.end()
-        , [e](WorkerPtr t) { return e.get() == t.get(); }
-      );
-      
-      assert(ita != All.end());
+    e = prev;
+  }
+}
 
-      e->Stop();
-      ThreadsStopped++;
+void Pool::Locked_StopWorker(Worker* p)
+{
+  assert(Unused.Contains(p));
 
-      auto c0 = e.use_count();
-      assert(c0 == 3);
+  p->Stop();
+  ThreadsStopped++;
 
-      Unused.erase(it);
-      ThreadsUnused = Unused.size();
+  WorkerPtr e = Unused.Remove(p);
 
-      All.erase(ita);
-      ThreadsTotal = All.size();
+  Locked_Unbind(p);
+  All.Remove(p);
+  Locked_UpdateCounters();
 
-      auto c1 = e.use_count();
-      assert(c1 == 1);
+  assert(e.use_count() == 1);
+}
 
-      cont = true;
-      break;
+size_t Pool::GetGrain(size_t count, size_t grain) const
+{
+  if (grain)
+    return grain;
+
+  size_t threads = ThreadLimit + 1;
+  return std::max<size_t>(1, count / (8 * threads));
+}
+
+void Pool::ParallelFor(
+  size_t first
+  , size_t last
+  , size_t grain
+  , const TChunk& fn
+)
+{
+  if (first >= last)
+    return;
+
+  grain = GetGrain(last - first, grain);
+  size_t chunks = (last - first - 1) / grain + 1;
+
+  std::atomic<size_t> next(first);
+  std::mutex errorLock;
+  std::exception_ptr error;
+
+  auto work = [&]()
+  {
+    for (;;)
+    {
+      size_t begin = next.fetch_add(grain);
+      if (begin >= last)
+        break;
+
+      try
+      {
+        fn(begin, begin + std::min(grain, last - begin));
+      }
+      catch (...)
+      {
+        std::lock_guard guard(errorLock);
+        if (error == nullptr)
+          error = std::current_exception();
+
+        // Other threads stop after the current chunk
+        next = last;
+        break;
+      }
     }
+  };
+
+  // Helpers which are not started when chunks are over exit immediately
+  HEvent done;
+  size_t helpers = std::min(chunks - 1, size_t(ThreadLimit));
+
+  if (helpers)
+  {
+    std::vector<TCallback> batch(helpers, work);
+    RunBatch2(batch, &done, OVERFLOW_MODE::FAIL);
   }
 
-  if (setTimer)
-    SET_TIMER();
+  work();
+
+  if (done)
+    WaitForSingleObject(done);
+
+  if (error)
+    std::rethrow_exception(error);
 }
@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <cassert>
-#include <exception>
+#include <cerrno>
+#include <cstring>
 #include <random>
-#include <system_error>
 
+#include <Syncme/Futex.h>
 #include <Syncme/Logger/Log.h>
 #include <Syncme/ProcessThreadId.h>
 #include <Syncme/SetThreadName.h>
@@ -14,36 +16,125 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#include <process.h>
+#else
+#include <limits.h>
+#include <pthread.h>
 #endif
 
 #pragma warning(disable : 4996)
 
 using namespace Syncme::ThreadPool;
 
+#define STATE_VALUE(s) uint32_t(WORKER_STATE::s)
+
 namespace Syncme::ThreadPool
 {
   std::atomic<uint64_t> WorkersDescructed;
 }
 uint64_t Syncme::ThreadPool::GetWorkersDescructed() {return WorkersDescructed;}
 
+static thread_local Worker* CurrentWorker;
+
+struct Worker::NativeThread
+{
+#ifdef _WIN32
+  HANDLE Handle = nullptr;
+  unsigned ID = 0;
+
+  static unsigned __stdcall Proc(void* p)
+  {
+    ((Worker*)p)->EntryPoint();
+    return 0;
+  }
+#else
+  pthread_t Handle{};
+
+  static void* Proc(void* p)
+  {
+    ((Worker*)p)->EntryPoint();
+    return nullptr;
+  }
+#endif
+
+  bool Create(Worker* worker, size_t stackSize)
+  {
+#ifdef _WIN32
+    Handle = (HANDLE)_beginthreadex(
+      nullptr
+      , unsigned(stackSize)
+      , &Proc
+      , worker
+      , stackSize ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0
+      , &ID
+    );
+
+    if (Handle == nullptr)
+    {
+      LogE("Unable to start thread: %s (code=%d)", strerror(errno), errno);
+      return false;
+    }
+#else
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    if (stackSize)
+    {
+      size_t size = std::max<size_t>(stackSize, PTHREAD_STACK_MIN);
+
+      int rc = pthread_attr_setstacksize(&attr, size);
+      if (rc)
+        LogW("Unable to set stack size %zu (code=%d)", size, rc);
+    }
+
+    int rc = pthread_create(&Handle, &attr, &Proc, worker);
+    pthread_attr_destroy(&attr);
+
+    if (rc)
+    {
+      LogE("Unable to start thread: %s (code=%d)", strerror(rc), rc);
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  void Join()
+  {
+#ifdef _WIN32
+    ::WaitForSingleObject(Handle, INFINITE);
+    ::CloseHandle(Handle);
+#else
+    pthread_join(Handle, nullptr);
+#endif
+  }
+
+  void Detach()
+  {
+#ifdef _WIN32
+    ::CloseHandle(Handle);
+#else
+    pthread_detach(Handle);
+#endif
+  }
+};
+
 Worker::Worker(
-  HEvent managementTimer
-  , TOnIdle notifyIdle
+  TOnIdle notifyIdle
   , TOnTimer onTimer
 )
-  : ManagementTimer(managementTimer)
-  , StartedEvent(CreateNotificationEvent())
-  , StopEvent(CreateNotificationEvent())
-  , IdleEvent(CreateNotificationEvent())
-  , BusyEvent(CreateSynchronizationEvent())
-  , InvokeEvent(CreateNotificationEvent())
-  , ExpireTimer(CreateManualResetTimer())
+  : State(STATE_VALUE(STARTING))
   , ThreadID{}
+  , StackSize(0)
   , Started(false)
   , Stopped(false)
   , Exited(false)
   , NotifyIdle(notifyIdle)
   , OnTimer(onTimer)
+  , IdleSince{}
+  , IdleTimeout(FOREVER)
+  , LastRunTime(0)
+  , Executed(0)
 {
 }
 
@@ -51,13 +142,6 @@ Worker::~Worker()
 {
   assert(Stopped == true);
 
-  CloseHandle(StartedEvent);
-  CloseHandle(StopEvent);
-  CloseHandle(IdleEvent);
-  CloseHandle(BusyEvent);
-  CloseHandle(InvokeEvent);
-  CloseHandle(ExpireTimer);
-
   WorkersDescructed++;
 }
 
@@ -66,10 +150,9 @@ WorkerPtr Worker::Get()
   return shared_from_this();
 }
 
-HEvent Worker::Handle()
+Worker* Worker::GetCurrent()
 {
-  HEvent h = DuplicateHandle(IdleEvent);
-  return h;
+  return CurrentWorker;
 }
 
 uint64_t Worker::GetTid() const
@@ -77,23 +160,46 @@ uint64_t Worker::GetTid() const
   return ThreadID;
 }
 
-void Worker::SetExpireTimer(long ms)
+uint64_t Worker::GetLastRunTime() const
 {
-  if (ms)
-    SetWaitableTimer(ExpireTimer, ms, 0, nullptr);
-  else
-    SetEvent(ExpireTimer);
+  return LastRunTime;
+}
+
+uint64_t Worker::GetExecuted() const
+{
+  return Executed;
+}
+
+void Worker::SetIdleSince(uint64_t t)
+{
+  IdleSince = t;
+}
+
+uint64_t Worker::GetIdleSince() const
+{
+  return IdleSince;
+}
+
+void Worker::SetIdleTimeout(uint32_t ms)
+{
+  IdleTimeout = ms;
 }
 
-void Worker::CancelExpireTimer()
+void Worker::SetAffinity(const CpuSet& cpus)
 {
-  CancelWaitableTimer(ExpireTimer);
-  ResetEvent(ExpireTimer);
+  assert(Started == false);
+  Affinity = cpus;
 }
 
-bool Worker::IsExpired() const
+const Syncme::CpuSet& Worker::GetAffinity() const
 {
-  return GetEventState(ExpireTimer) == STATE::SIGNALLED;
+  return Affinity;
+}
+
+void Worker::SetStackSize(size_t size)
+{
+  assert(Started == false);
+  StackSize = size;
 }
 
 HEvent Worker::Start(TCallback cb, uint64_t* id)
@@ -107,66 +213,37 @@ HEvent Worker::Start(TCallback cb, uint64_t* id)
   if (Thread)
     return HEvent();
 
-  if (!StopEvent || !IdleEvent || !BusyEvent || !InvokeEvent || !ExpireTimer)
-    return HEvent();
-
-  HEvent h = Handle();
+  HEvent h = CreateNotificationEvent();
   if (h == nullptr)
     return HEvent();
 
-  if (true)
-  {
-    auto guard = StateLock.Lock();
-
-    Callback = cb;
-
-    try
-    {
-      Thread = std::make_shared<std::thread>(&Worker::EntryPoint, this);
-    }
-    catch (const std::system_error& e)
-    {
-      LogE(
-        "Unable to start thread: %s (code=%d)"
-        , e.what()
-        , (int)e.code().value()
-      );
-
-      Callback = TCallback();
-      return HEvent();
-    }
-    catch (const std::exception& e)
-    {
-      LogE("Unable to start thread: %s", e.what());
-
-      Callback = TCallback();
-      return HEvent();
-    }
-    catch (...)
-    {
-      LogE("Unable to start thread: unknown exception");
-
-      Callback = TCallback();
-      return HEvent();
-    }
-
-    if (Thread == nullptr)
-    {
-      LogE("Unable to start thread");
+  Callback = cb;
 
-      Callback = TCallback();
-      return HEvent();
-    }
+  // Worker without a task becomes idle at once
+  if (cb)
+    Completion = h;
+  else
+    SetEvent(h);
 
-    Started = true;
+  auto thread = std::make_unique<NativeThread>();
+  if (thread->Create(this, StackSize) == false)
+  {
+    Callback = TCallback();
+    Completion.reset();
+    return HEvent();
   }
 
+  Thread = std::move(thread);
+  Started = true;
+
   if (id)
   {
 #ifdef _WIN32
-    *id = GetThreadId((HANDLE)Thread->native_handle());
+    *id = Thread->ID;
 #else
-    WaitForSingleObject(StartedEvent);
+    while (State.load(std::memory_order_acquire) == STATE_VALUE(STARTING))
+      FutexWait(State, STATE_VALUE(STARTING));
+
     *id = ThreadID;
 #endif
   }
@@ -181,16 +258,19 @@ void Worker::Stop()
 
   if (Thread)
   {
-    SetEvent(StopEvent);
+    uint32_t prev = State.exchange(STATE_VALUE(STOPPING), std::memory_order_acq_rel);
+    if (prev == STATE_VALUE(PARKED))
+      FutexWakeOne(State);
 
     // Do not wait for thread termination if object is deleted from OnFree()
     auto id = GetCurrentThreadId();
 
-    assert(ThreadID);
     assert(id != ThreadID);
 
     if (id != ThreadID)
-      Thread->join();
+      Thread->Join();
+    else
+      Thread->Detach();
 
     Thread.reset();
     ThreadID = 0;
@@ -204,16 +284,6 @@ HEvent Worker::Invoke(TCallback cb, uint64_t& id)
   assert(Started == true);
   assert(Stopped == false);
   assert(Exited == false);
-
-  auto stateExpired = GetEventState(ExpireTimer);
-  auto stateBusy = GetEventState(BusyEvent);
-  auto stateIdle = GetEventState(IdleEvent);
-  auto stateInvoke = GetEventState(InvokeEvent);
-
-  assert(stateExpired == STATE::NOT_SIGNALLED);
-  assert(stateBusy == STATE::NOT_SIGNALLED);
-  assert(stateIdle == STATE::SIGNALLED);
-  assert(stateInvoke == STATE::NOT_SIGNALLED);
   assert(Thread);
 
   if (!Thread)
@@ -221,110 +291,154 @@ HEvent Worker::Invoke(TCallback cb, uint64_t& id)
 
   id = ThreadID;
 
-  HEvent h = Handle();
+  HEvent h = CreateNotificationEvent();
   if (h == nullptr)
     return nullptr;
 
+  // Worker does not touch Callback and Completion in IDLE / PARKED 
+  // states. They are published to it by the exchange below
   Callback = cb;
+  Completion = h;
 
-  // Acquire StateLock to prevent NotifyIdle() called till WaitForMultipleObjects() completion
-  auto guard = StateLock.Lock();
-
-  ResetEvent(IdleEvent);
-  ResetEvent(BusyEvent);
+  uint32_t prev = State.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    if (prev != STATE_VALUE(IDLE) && prev != STATE_VALUE(PARKED))
+    {
+      assert(prev == STATE_VALUE(STOPPING));
 
-  SetEvent(InvokeEvent);
+      Callback = TCallback();
+      Completion.reset();
+      return nullptr;
+    }
 
-  EventArray object(StopEvent, BusyEvent);
+    if (State.compare_exchange_weak(prev, STATE_VALUE(INVOKED), std::memory_order_acq_rel))
+      break;
+  }
 
-  auto rc = WaitForMultipleObjects(object, false, FOREVER);
-  assert(rc == WAIT_RESULT::OBJECT_0 || rc == WAIT_RESULT::OBJECT_1);
+  if (prev == STATE_VALUE(PARKED))
+    FutexWakeOne(State);
 
   return h;
 }
 
-void Worker::EntryPoint()
+void Worker::Execute()
 {
-  char name[64];
-  sprintf(name, "TPool:%p", this);
+  uint64_t t0 = GetTimeInMicrosec();
 
-  ThreadID = GetCurrentThreadId();
-  SetEvent(StartedEvent);
-
-  SET_CUR_THREAD_NAME(name);
-  assert(Exited == false);
+  try
+  {
+    Callback();
+  }
+  catch (const std::exception& e)
+  {
+    LogE("Worker task threw exception: %s", e.what());
+  }
+  catch (...)
+  {
+    LogE("Worker task threw unknown exception");
+  }
 
-  EventArray object(StopEvent, InvokeEvent, ManagementTimer);
+  // Release captured objects before the handle is signalled
+  Callback = TCallback();
+  LastRunTime = GetTimeInMicrosec() - t0;
+  Executed++;
 
-  bool firstTask = true;
-  WAIT_RESULT rc = WAIT_RESULT::OBJECT_1;
-  goto OnInvoke;
+  // Completion has to be taken before the worker becomes IDLE. After 
+  // that Invoke() can assign a new one
+  HEvent completion;
+  completion.swap(Completion);
+  SetEvent(completion);
+}
 
+bool Worker::WaitForInvoke()
+{
   for (;;)
   {
-    firstTask = false;
+    uint32_t state = State.load(std::memory_order_acquire);
 
-    rc = WaitForMultipleObjects(object, false, FOREVER);
-    if (rc == WAIT_RESULT::OBJECT_0)
+    switch (WORKER_STATE(state))
+    {
+    case WORKER_STATE::INVOKED:
+      if (State.compare_exchange_strong(state, STATE_VALUE(BUSY), std::memory_order_acq_rel))
+        return true;
       break;
 
-    if (rc == WAIT_RESULT::OBJECT_2)
-    {
-      OnTimer(this);
-      continue;
-    }
+    case WORKER_STATE::STOPPING:
+      return false;
 
-    if (rc != WAIT_RESULT::OBJECT_1)
-    {
-      assert(!"!?!?!?!");
+    case WORKER_STATE::IDLE:
+      State.compare_exchange_strong(state, STATE_VALUE(PARKED), std::memory_order_acq_rel);
       break;
-    }
 
-  OnInvoke:
-    ResetEvent(InvokeEvent);
-    
-    if (firstTask == false)
-      SetEvent(BusyEvent);
+    case WORKER_STATE::PARKED:
+      if (FutexWait(State, state, IdleTimeout) == false)
+      {
+        // Idle timeout is handled in IDLE state. Invoke() does not 
+        // need to wake the worker till it calls FutexWait() again
+        if (State.compare_exchange_strong(state, STATE_VALUE(IDLE), std::memory_order_acq_rel))
+          OnTimer(this);
+      }
+      break;
 
-    try
-    {
-      Callback();
-    }
-    catch (const std::exception& e)
-    {
-      LogE("Worker task threw exception: %s", e.what());
-    }
-    catch (...)
-    {
-      LogE("Worker task threw unknown exception");
+    default:
+      assert(!"unexpected worker state");
+      return false;
     }
+  }
+}
+
+void Worker::EntryPoint()
+{
+  char name[64];
+  sprintf(name, "TPool:%p", this);
+
+  ThreadID = GetCurrentThreadId();
+  CurrentWorker = this;
+
+  if (Affinity.empty())
+    ApplyRuntimeAffinity();
+  else
+    SetCurrentThreadAffinity(Affinity);
+
+  // Start() can wait for ThreadID. State can be already STOPPING
+  uint32_t state = STATE_VALUE(STARTING);
+  State.compare_exchange_strong(state, STATE_VALUE(BUSY), std::memory_order_acq_rel);
+  FutexWakeAll(State);
+
+  SET_CUR_THREAD_NAME(name);
+  assert(Exited == false);
 
-    // We use IdleEvent to emulate thread handle. Clients can use it to 
-    // check that thread is exited. So we return duplicated handle from Handle(),
-    // signal event here. We have to create new event to work with new client
-    SetEvent(IdleEvent);
-    CloseHandle(IdleEvent);
-    
-    IdleEvent = CreateNotificationEvent(STATE::SIGNALLED);
-    if (IdleEvent == nullptr)
+  // Worker which was started without a task calls NotifyIdle() at once
+  bool execute = bool(Callback);
+
+  for (;;)
+  {
+    if (execute)
     {
-      LogE("IdleEvent: CreateCommonEvent failed");
-      break;
+      Execute();
+      SET_CUR_THREAD_NAME(name);
     }
 
-    SET_CUR_THREAD_NAME(name);
+    execute = true;
+
+    // Fails if Stop() was called. It is checked by WaitForInvoke()
+    state = STATE_VALUE(BUSY);
+    State.compare_exchange_strong(state, STATE_VALUE(IDLE), std::memory_order_acq_rel);
 
-    auto guard = StateLock.Lock();
     TaskPtr task = NotifyIdle(this);
-    
     if (task)
     {
       Callback = task->Callback;
-      firstTask = true;
-      
-      guard.Release();
-      goto OnInvoke;
+      Completion = task->ThreadHandle;
+
+      state = STATE_VALUE(IDLE);
+      State.compare_exchange_strong(state, STATE_VALUE(BUSY), std::memory_order_acq_rel);
+      continue;
     }
+
+    if (!WaitForInvoke())
+      break;
   }
 
   Exited = true;
@@ -1,3 +1,5 @@
+#include <chrono>
+
 #include <Syncme/TickCount.h>
 
 #if defined(__GNUC__)
@@ -31,4 +33,10 @@ uint64_t Syncme::GetTimeInMillisec()
     return clocks * (1000 / CLOCKS_PER_SEC);
   }
 #endif
-} 
\ No newline at end of file
+} 
+
+uint64_t Syncme::GetTimeInMicrosec()
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
\ No newline at end of file
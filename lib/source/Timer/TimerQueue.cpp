@@ -1,5 +1,6 @@
 #include <cassert>
 
+#include <Syncme/Affinity.h>
 #include <Syncme/SetThreadName.h>
 #include <Syncme/TickCount.h>
 #include <Syncme/Timer/Counter.h>
@@ -232,6 +233,7 @@ void TimerQueue::SignallTimers()
 void TimerQueue::Worker()
 {
   SET_CUR_THREAD_NAME("TimerQueue Worker");
+  ApplyRuntimeAffinity();
   EventArray object(EvStop, EvUpdate);
 
   for (uint64_t dueTime{};;)
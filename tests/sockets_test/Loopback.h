@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/SocketPair.h>
+
+// Returns a socket listening on 127.0.0.1 at a free port or -1
+static int CreateLoopbackListener()
+{
+  int h = (int)socket(AF_INET, SOCK_STREAM, 0);
+  if (h == -1)
+    return -1;
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(h, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(h, SOMAXCONN) != 0)
+  {
+    closesocket(h);
+    return -1;
+  }
+
+  return h;
+}
+
+// Connects two sockets over 127.0.0.1. If listener is -1, it is created
+// by CreateLoopbackListener() and the caller has to close it. c is the
+// connecting socket, s is the accepted one
+static bool ConnectLoopback(int& listener, int& c, int& s)
+{
+  c = -1;
+  s = -1;
+
+  if (listener == -1)
+  {
+    listener = CreateLoopbackListener();
+    if (listener == -1)
+      return false;
+  }
+
+  sockaddr_in addr{};
+  socklen_t len = sizeof(addr);
+  if (getsockname(listener, (sockaddr*)&addr, &len) != 0)
+    return false;
+
+  c = (int)socket(AF_INET, SOCK_STREAM, 0);
+  if (c == -1 || connect(c, (sockaddr*)&addr, sizeof(addr)) != 0)
+    return false;
+
+  s = (int)accept(listener, nullptr, nullptr);
+  return s != -1;
+}
+
+// Same as ConnectLoopback() but the accepted socket is attached to
+// pair.Client and the connecting one to pair.Server
+static bool MakeLoopbackPair(Syncme::SocketPair& pair, int& listener)
+{
+  int c = -1;
+  int s = -1;
+
+  if (ConnectLoopback(listener, c, s) == false)
+    return false;
+
+  pair.Client = pair.CreateBIOSocket();
+  pair.Server = pair.CreateBIOSocket();
+
+  return pair.Client->Attach(s)
+    && pair.Client->Configure()
+    && pair.Server->Attach(c)
+    && pair.Server->Configure();
+}
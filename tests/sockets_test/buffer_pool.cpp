@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Sockets/Async/BufferChain.h>
+#include <Syncme/Sockets/BufferPool.h>
+#include <Syncme/TickCount.h>
+
+using namespace Syncme;
+using namespace Syncme::Sockets::IO;
+
+static const size_t Rounds = 100000;
+static const size_t Connections = 16;
+
+TEST(Sockets, buffer_pool)
+{
+  TrimBufferPool();
+
+  // Size classes
+  auto b = AllocateBuffer(100);
+  EXPECT_GE(b->capacity(), 4096);
+  FreeBuffer(b);
+
+  b = AllocateBuffer(20000);
+  EXPECT_GE(b->capacity(), 64 * 1024);
+  FreeBuffer(b);
+
+  BufferPoolStats s0 = GetBufferPoolStats();
+  EXPECT_GT(s0.Held, 0);
+
+  b = AllocateBuffer(100);
+  EXPECT_EQ(GetBufferPoolStats().Hits, s0.Hits + 1);
+  FreeBuffer(b);
+
+  // Buffers released by a thread are taken by another one from the depot
+  std::thread producer(
+    []()
+    {
+      std::vector<BufferPtr> buffers;
+      for (size_t i = 0; i < MAGAZINE_SIZE * 2; i++)
+        buffers.push_back(AllocateBuffer(BUFFER_SIZE));
+
+      for (auto& b : buffers)
+        FreeBuffer(b);
+    }
+  );
+  producer.join();
+
+  BufferPoolStats s1 = GetBufferPoolStats();
+  b = AllocateBuffer(BUFFER_SIZE);
+  EXPECT_EQ(GetBufferPoolStats().Hits, s1.Hits + 1);
+  FreeBuffer(b);
+
+  // Memory above the limit is freed
+  SetBufferPoolLimit(BUFFER_SIZE);
+  EXPECT_LE(GetBufferPoolStats().Held, BUFFER_SIZE * (MAGAZINE_SIZE + 1));
+
+  std::vector<BufferPtr> buffers;
+  for (size_t i = 0; i < 4; i++)
+    buffers.push_back(AllocateBuffer(BUFFER_SIZE));
+
+  TrimBufferPool();
+  size_t held = GetBufferPoolStats().Held;
+
+  for (auto& b : buffers)
+    FreeBuffer(b);
+
+  EXPECT_LE(GetBufferPoolStats().Held, std::max(held, BUFFER_SIZE));
+  SetBufferPoolLimit(POOL_LIMIT);
+
+  // Buffers of a chain go back to the pool
+  Sockets::Async::BufferChain chain;
+  EXPECT_TRUE(chain.Append("hello", 5));
+  EXPECT_EQ(chain.Size(), 5);
+
+  BufferPoolStats s2 = GetBufferPoolStats();
+  chain.Clear();
+  EXPECT_GT(GetBufferPoolStats().Held, s2.Held);
+}
+
+// Each round closes a connection and opens a new one, which gets
+// BUFFER_SIZE buffers for its queues
+TEST(Sockets, buffer_pool_churn)
+{
+  std::vector<BufferPtr> connections(Connections);
+
+  uint64_t t0 = GetTimeInMicrosec();
+  for (size_t i = 0; i < Rounds; i++)
+  {
+    auto b = std::make_shared<Buffer>();
+    b->reserve(BUFFER_SIZE);
+    b->resize(512);
+    connections[i % Connections] = b;
+  }
+  uint64_t heap = GetTimeInMicrosec() - t0;
+
+  BufferPoolStats s0 = GetBufferPoolStats();
+
+  t0 = GetTimeInMicrosec();
+  for (size_t i = 0; i < Rounds; i++)
+  {
+    auto b = AllocateBuffer(BUFFER_SIZE);
+    b->resize(512);
+    FreeBuffer(connections[i % Connections]);
+    connections[i % Connections] = b;
+  }
+  uint64_t pool = GetTimeInMicrosec() - t0;
+
+  BufferPoolStats s1 = GetBufferPoolStats();
+  double hits = double(s1.Hits - s0.Hits) * 100 / double(s1.Requests - s0.Requests);
+
+  printf("\n=== %zu allocations of %zu KiB ===\n", Rounds, BUFFER_SIZE / 1024);
+  printf("make_shared : %.1f ms\n", double(heap) / 1000);
+  printf("pool        : %.1f ms, hit rate %.1f%%, held %zu KiB\n"
+    , double(pool) / 1000
+    , hits
+    , s1.Held / 1024
+  );
+
+  EXPECT_GT(hits, 90.0);
+}
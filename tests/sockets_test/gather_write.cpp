@@ -0,0 +1,140 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/SocketPair.h>
+
+#include "Loopback.h"
+
+using namespace Syncme;
+using namespace Syncme::Sockets::IO;
+
+static const size_t NumRecords = 4096;
+static const size_t RecordSize = 64;
+
+TEST(Sockets, queue_consume)
+{
+  Queue q;
+  EXPECT_TRUE(q.Append("abc", 3));
+  EXPECT_TRUE(q.Append("defg", 4));
+  EXPECT_TRUE(q.Append("h", 1));
+
+  Span spans[8]{};
+  EXPECT_EQ(q.GetSpans(spans, 8), 3);
+  EXPECT_EQ(spans[1].Size, 4);
+
+  // Partially sent buffer stays at the head of the queue
+  q.Consume(5);
+  EXPECT_EQ(q.Size(), 3);
+  EXPECT_EQ(q.Count(), 2);
+
+  EXPECT_EQ(q.GetSpans(spans, 8), 2);
+  EXPECT_EQ(std::string(spans[0].Data, spans[0].Size), "fg");
+  EXPECT_EQ(std::string(spans[1].Data, spans[1].Size), "h");
+
+  // Consumed bytes are not returned by PopFirst()
+  auto b = q.PopFirst();
+  EXPECT_EQ(std::string(b->data(), b->size()), "fg");
+  EXPECT_EQ(q.Size(), 1);
+
+  q.Consume(1);
+  EXPECT_TRUE(q.IsEmpty());
+  EXPECT_EQ(q.GetSpans(spans, 8), 0);
+
+  // Sent buffers are not kept by the queue
+  size_t queued = 0, cached = 0;
+  q.GetMemoryUsage(queued, cached);
+  EXPECT_EQ(cached, 0);
+}
+
+TEST(Sockets, gather_write)
+{
+  Logme::ID ch = CH;
+  HEvent exitEvent = CreateNotificationEvent();
+  ConfigPtr config = std::make_shared<Config>();
+
+  int h = -1;
+  int c = -1;
+  int s = -1;
+  ASSERT_TRUE(ConnectLoopback(h, c, s));
+
+  // Small kernel buffers make the writes to be queued
+  int small = 4096;
+  setsockopt(c, SOL_SOCKET, SO_RCVBUF, (const char*)&small, sizeof(small));
+  setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&small, sizeof(small));
+
+  SocketPair pair(ch, exitEvent, config);
+  pair.Client = pair.CreateBIOSocket();
+  EXPECT_TRUE(pair.Client->Attach(s));
+  EXPECT_TRUE(pair.Client->Configure());
+
+  // Nobody reads yet, so the records end up in TxQueue
+  size_t total = 0;
+  size_t queued = 0;
+  std::vector<char> record(RecordSize);
+
+  for (size_t i = 0; i < NumRecords; i++)
+  {
+    memset(record.data(), 'a' + int(i % 26), RecordSize);
+
+    bool q = false;
+    EXPECT_EQ(pair.Client->Write(record.data(), RecordSize, 0, &q), int(RecordSize));
+
+    total += RecordSize;
+    queued += q ? 1 : 0;
+  }
+
+  std::vector<char> received;
+  std::thread reader(
+    [c, total, &received]()
+    {
+      std::vector<char> buffer(64 * 1024);
+      while (received.size() < total)
+      {
+        auto n = recv(c, buffer.data(), buffer.size(), 0);
+        if (n <= 0)
+          break;
+
+        received.insert(received.end(), buffer.data(), buffer.data() + n);
+      }
+    }
+  );
+
+  IOStat stat{};
+  IOFlags flags{};
+  flags.f.Flush = true;
+
+  while (pair.Client->TxQueue.IsEmpty() == false)
+  {
+    if (pair.Client->IO(5000, stat, flags) == false)
+      break;
+  }
+
+  reader.join();
+
+  EXPECT_TRUE(pair.Client->TxQueue.IsEmpty());
+  EXPECT_EQ(received.size(), total);
+
+  for (size_t i = 0; i < received.size(); i++)
+  {
+    if (received[i] != 'a' + int((i / RecordSize) % 26))
+    {
+      ADD_FAILURE() << "data mismatch at " << i;
+      break;
+    }
+  }
+
+  // Each send takes all queued buffers which fit in the socket
+  printf("%zu records queued, sent by %zu calls\n", queued, stat.SentPkt);
+  EXPECT_LT(stat.SentPkt, queued);
+
+  pair.Close(SocketPairCloseMode::Fast);
+  closesocket(c);
+  closesocket(h);
+}
@@ -0,0 +1,61 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/SocketPair.h>
+
+#include "Loopback.h"
+
+using namespace Syncme;
+
+TEST(Sockets, memory_usage)
+{
+  Logme::ID ch = CH;
+  HEvent exitEvent = CreateNotificationEvent();
+  ConfigPtr config = std::make_shared<Config>();
+
+  int h = -1;
+  SocketPair pair(ch, exitEvent, config);
+  ASSERT_TRUE(MakeLoopbackPair(pair, h));
+
+  size_t idle = pair.GetMemoryUsage();
+
+  // Socket does not embed receive buffers
+  SocketMemory m = pair.Client->GetMemoryUsage();
+  EXPECT_LT(m.Object, Sockets::IO::BUFFER_SIZE);
+  EXPECT_EQ(m.RxQueued, 0);
+
+  // Unread data is counted
+  EXPECT_EQ(pair.Server->WriteStr("keep-alive"), 10);
+
+  IOStat stat{};
+  pair.Client->IO(1000, stat);
+
+  // Small read takes a buffer of the matching size class
+  m = pair.Client->GetMemoryUsage();
+  EXPECT_GT(m.RxQueued, 0);
+  EXPECT_LT(m.RxQueued, Sockets::IO::BUFFER_SIZE);
+
+  // Read buffer goes to the cache of the thread
+  char buffer[64]{};
+  EXPECT_EQ(pair.Client->Read(buffer, sizeof(buffer), 1000), 10);
+
+  m = pair.Client->GetMemoryUsage();
+  EXPECT_EQ(m.RxQueued, 0);
+  EXPECT_EQ(m.Cached, 0);
+  EXPECT_EQ(pair.GetMemoryUsage(), idle);
+  EXPECT_GT(Sockets::IO::GetScratchMemory(), 0);
+
+  printf("pair: %zu bytes, socket object: %zu bytes, scratch: %zu bytes\n"
+    , idle
+    , m.Object
+    , Sockets::IO::GetScratchMemory()
+  );
+
+  pair.Close(SocketPairCloseMode::Fast);
+  closesocket(h);
+}
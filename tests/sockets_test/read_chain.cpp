@@ -0,0 +1,68 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/SocketPair.h>
+
+#include "Loopback.h"
+
+using namespace Syncme;
+using namespace Syncme::Sockets;
+
+static std::string ChainToString(const Async::BufferChain& chain)
+{
+  IO::Span spans[16]{};
+  size_t count = chain.GetSpans(spans, 16);
+
+  std::string s;
+  for (size_t i = 0; i < count; i++)
+    s.append(spans[i].Data, spans[i].Size);
+
+  return s;
+}
+
+TEST(Sockets, read_chain)
+{
+  Logme::ID ch = CH;
+  HEvent exitEvent = CreateNotificationEvent();
+  ConfigPtr config = std::make_shared<Config>();
+
+  int h = -1;
+  SocketPair pair(ch, exitEvent, config);
+  ASSERT_TRUE(MakeLoopbackPair(pair, h));
+
+  EXPECT_EQ(pair.Server->WriteStr("GET / HTTP/1.1\r\n"), 16);
+
+  // Part of a received buffer is taken by the chain
+  Async::BufferChain chain;
+  EXPECT_EQ(pair.Client->ReadV(chain, 4, 1000), 4);
+  EXPECT_EQ(ChainToString(chain), "GET ");
+
+  // The rest is returned by Read() while the chain keeps its part
+  char buffer[64]{};
+  EXPECT_EQ(pair.Client->Read(buffer, sizeof(buffer), 1000), 12);
+  EXPECT_EQ(std::string(buffer, 12), "/ HTTP/1.1\r\n");
+  EXPECT_EQ(ChainToString(chain), "GET ");
+
+  chain.Clear();
+
+  // SocketPair reads from any of the sockets
+  EXPECT_EQ(pair.Client->WriteStr("Host: x\r\n"), 9);
+
+  SocketPtr from;
+  EXPECT_EQ(pair.ReadV(chain, IO::BUFFER_SIZE, from, 1000), 9);
+  EXPECT_EQ(from, pair.Server);
+  EXPECT_EQ(ChainToString(chain), "Host: x\r\n");
+
+  // Nothing to read
+  EXPECT_EQ(pair.ReadV(chain, IO::BUFFER_SIZE, from, 50), 0);
+  EXPECT_EQ(chain.Size(), 9);
+
+  pair.Close(SocketPairCloseMode::Fast);
+  closesocket(h);
+}
@@ -0,0 +1,205 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/SocketPair.h>
+#include <Syncme/TickCount.h>
+
+#include "Loopback.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+
+using namespace Syncme;
+
+static const size_t TransferSize = 256ULL * 1024 * 1024;
+static const size_t ChunkSize = 64ULL * 1024;
+
+// Source -> pair.Client ... pair.Server -> Sink
+struct RelaySetup
+{
+  int Listener;
+  int Source;
+  int Sink;
+  HEvent ExitEvent;
+  std::unique_ptr<SocketPair> Pair;
+
+  RelaySetup()
+    : Listener(-1)
+    , Source(-1)
+    , Sink(-1)
+  {
+    int client = -1;
+    int server = -1;
+
+    EXPECT_TRUE(ConnectLoopback(Listener, Source, client));
+    EXPECT_TRUE(ConnectLoopback(Listener, server, Sink));
+
+    Logme::ID ch = CH;
+    ExitEvent = CreateNotificationEvent();
+    Pair = std::make_unique<SocketPair>(ch, ExitEvent, std::make_shared<Config>());
+
+    Pair->Client = Pair->CreateBIOSocket();
+    Pair->Server = Pair->CreateBIOSocket();
+
+    EXPECT_TRUE(Pair->Client->Attach(client));
+    EXPECT_TRUE(Pair->Client->Configure());
+    EXPECT_TRUE(Pair->Server->Attach(server));
+    EXPECT_TRUE(Pair->Server->Configure());
+  }
+
+  ~RelaySetup()
+  {
+    Pair->Close(SocketPairCloseMode::Fast);
+
+    closesocket(Source);
+    closesocket(Sink);
+    closesocket(Listener);
+  }
+};
+
+static double ThreadCpuTime()
+{
+  rusage ru{};
+  getrusage(RUSAGE_THREAD, &ru);
+
+  return double(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)
+    + double(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000;
+}
+
+// Relays TransferSize bytes from Source to Sink. Returns throughput in
+// MiB/s and CPU time of the relaying thread per GiB
+static void RunRelay(bool splice, double& throughput, double& cpu)
+{
+  RelaySetup setup;
+
+  std::thread sender(
+    [&setup]()
+    {
+      std::vector<char> chunk(ChunkSize, 'x');
+      for (size_t sent = 0; sent < TransferSize;)
+      {
+        auto n = send(setup.Source, chunk.data(), chunk.size(), MSG_NOSIGNAL);
+        if (n <= 0)
+          break;
+
+        sent += size_t(n);
+      }
+
+      shutdown(setup.Source, SHUT_WR);
+    }
+  );
+
+  size_t received = 0;
+  std::thread receiver(
+    [&setup, &received]()
+    {
+      std::vector<char> buffer(ChunkSize);
+      for (;;)
+      {
+        auto n = recv(setup.Sink, buffer.data(), buffer.size(), 0);
+        if (n <= 0)
+          break;
+
+        received += size_t(n);
+      }
+
+      shutdown(setup.Sink, SHUT_WR);
+    }
+  );
+
+  uint64_t t0 = GetTimeInMicrosec();
+  double c0 = ThreadCpuTime();
+
+  if (splice)
+  {
+    RelayStat stat{};
+    EXPECT_TRUE(setup.Pair->Relay(stat, 5000));
+    EXPECT_EQ(stat.ClientToServer, TransferSize);
+    EXPECT_EQ(stat.ServerToClient, 0);
+  }
+  else
+  {
+    std::vector<char> buffer(Sockets::IO::BUFFER_SIZE);
+    for (;;)
+    {
+      SocketPtr from;
+      int n = setup.Pair->Read(buffer, from, 5000);
+      if (n <= 0)
+        break;
+
+      SocketPtr to = from == setup.Pair->Client ? setup.Pair->Server : setup.Pair->Client;
+
+      // Write() can send a part of the data
+      for (int sent = 0; sent < n;)
+      {
+        int e = to->Write(buffer.data() + sent, size_t(n - sent));
+        if (e < 0)
+          break;
+
+        sent += e;
+        if (to->TxQueue.IsEmpty() == false)
+          to->Flush();
+      }
+    }
+
+    shutdown(setup.Pair->Server->Handle, SHUT_WR);
+  }
+
+  double spent = double(GetTimeInMicrosec() - t0) / 1000000;
+  double used = ThreadCpuTime() - c0;
+
+  sender.join();
+  receiver.join();
+
+  EXPECT_EQ(received, TransferSize);
+
+  double gib = double(TransferSize) / (1024 * 1024 * 1024);
+  throughput = double(TransferSize) / (1024 * 1024) / (spent > 0 ? spent : 1e-6);
+  cpu = used / gib;
+}
+
+TEST(Sockets, relay_throughput)
+{
+  double copyRate = 0, copyCpu = 0;
+  double spliceRate = 0, spliceCpu = 0;
+
+  RunRelay(false, copyRate, copyCpu);
+  RunRelay(true, spliceRate, spliceCpu);
+
+  printf("\n=== relay over loopback, %zu MiB ===\n", TransferSize / (1024 * 1024));
+  printf("Read/Write : %.0f MiB/s, %.2f CPU sec per GiB\n", copyRate, copyCpu);
+  printf("Relay      : %.0f MiB/s, %.2f CPU sec per GiB\n", spliceRate, spliceCpu);
+}
+
+TEST(Sockets, relay_events)
+{
+  RelaySetup setup;
+
+  // Data received before relaying is passed on
+  EXPECT_EQ(send(setup.Source, "hello", 5, 0), 5);
+  IOStat io{};
+  setup.Pair->Client->IO(1000, io);
+
+  RelayStat stat{};
+  EXPECT_FALSE(setup.Pair->Relay(stat, 100));
+  EXPECT_EQ(setup.Pair->Client->GetLastError().Code, SKT_ERROR::TIMEOUT);
+  EXPECT_EQ(stat.ClientToServer, 5);
+
+  char buffer[16]{};
+  EXPECT_EQ(recv(setup.Sink, buffer, sizeof(buffer), 0), 5);
+
+  // Exit event stops the relay
+  std::thread stopper([&setup]() { Sleep(50); SetEvent(setup.ExitEvent); });
+  EXPECT_FALSE(setup.Pair->Relay(stat, FOREVER));
+  EXPECT_EQ(setup.Pair->Client->GetLastError().Code, SKT_ERROR::CONNECTION_ABORTED);
+  stopper.join();
+}
+#endif
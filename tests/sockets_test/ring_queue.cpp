@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Sockets/Queue.h>
+#include <Syncme/Sockets/RingQueue.h>
+#include <Syncme/TickCount.h>
+
+using namespace Syncme;
+using namespace Syncme::Sockets::IO;
+
+static const size_t TransferSize = 256ULL * 1024 * 1024;
+static const size_t ChunkSize = 1024;
+
+TEST(Sockets, ring_queue)
+{
+  RingQueue q(100);
+  EXPECT_EQ(q.GetCapacity(), 128);
+
+  std::vector<char> data(100);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = char(i);
+
+  EXPECT_TRUE(q.Append(data.data(), 100));
+  EXPECT_FALSE(q.Append(data.data(), 29));
+
+  char buffer[128]{};
+  EXPECT_EQ(q.Read(buffer, 90), 90);
+  EXPECT_EQ(memcmp(buffer, data.data(), 90), 0);
+
+  // Data wraps around the end of the ring
+  size_t qsize = 0;
+  EXPECT_TRUE(q.Append(data.data(), 100, &qsize));
+  EXPECT_EQ(qsize, 110);
+
+  Span spans[2]{};
+  EXPECT_EQ(q.GetSpans(spans, 2), 2);
+  EXPECT_EQ(spans[0].Size + spans[1].Size, 110);
+
+  // Reserve returns contiguous space only
+  size_t size = 0;
+  EXPECT_NE(q.Reserve(size), nullptr);
+  EXPECT_EQ(size, 18);
+
+  q.Consume(10);
+  EXPECT_EQ(q.Read(buffer, sizeof(buffer)), 100);
+  EXPECT_EQ(memcmp(buffer, data.data(), 100), 0);
+  EXPECT_TRUE(q.IsEmpty());
+}
+
+// Producer appends chunks, consumer takes them. Returns MiB/s
+static double RunLockedQueue()
+{
+  Queue q(-1);
+  std::vector<char> chunk(ChunkSize, 'x');
+
+  uint64_t t0 = GetTimeInMicrosec();
+
+  std::thread producer(
+    [&]()
+    {
+      for (size_t sent = 0; sent < TransferSize; sent += ChunkSize)
+      {
+        while (q.Size() >= LIMIT)
+          std::this_thread::yield();
+
+        q.Append(chunk.data(), chunk.size());
+      }
+    }
+  );
+
+  size_t received = 0;
+  while (received < TransferSize)
+  {
+    auto b = q.PopFirst();
+    if (b == nullptr)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    received += b->size();
+    q.PushFree(b);
+  }
+
+  producer.join();
+
+  uint64_t spent = GetTimeInMicrosec() - t0;
+  return double(received) / (1024 * 1024) / (double(spent ? spent : 1) / 1000000);
+}
+
+static double RunRingQueue()
+{
+  RingQueue q(LIMIT);
+  std::vector<char> chunk(ChunkSize, 'x');
+
+  uint64_t t0 = GetTimeInMicrosec();
+
+  std::thread producer(
+    [&]()
+    {
+      for (size_t sent = 0; sent < TransferSize; sent += ChunkSize)
+      {
+        while (q.Append(chunk.data(), chunk.size()) == false)
+          std::this_thread::yield();
+      }
+    }
+  );
+
+  size_t received = 0;
+  Span spans[2];
+
+  while (received < TransferSize)
+  {
+    size_t count = q.GetSpans(spans, 2);
+    if (count == 0)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++)
+      n += spans[i].Size;
+
+    q.Consume(n);
+    received += n;
+  }
+
+  producer.join();
+
+  uint64_t spent = GetTimeInMicrosec() - t0;
+  return double(received) / (1024 * 1024) / (double(spent ? spent : 1) / 1000000);
+}
+
+TEST(Sockets, ring_queue_throughput)
+{
+  double locked = RunLockedQueue();
+  double ring = RunRingQueue();
+
+  printf("\n=== SPSC, %zu MiB by %zu byte chunks ===\n", TransferSize / (1024 * 1024), ChunkSize);
+  printf("Queue     : %.0f MiB/s\n", locked);
+  printf("RingQueue : %.0f MiB/s\n", ring);
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/SocketPair.h>
+
+#include "Loopback.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace Syncme;
+
+static const size_t FileSize = 4ULL * 1024 * 1024 + 123;
+static const size_t FileOffset = 5000;
+
+TEST(Sockets, send_file)
+{
+  Logme::ID ch = CH;
+  HEvent exitEvent = CreateNotificationEvent();
+  ConfigPtr config = std::make_shared<Config>();
+
+  char path[] = "/tmp/syncme_send_file_XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT_NE(fd, -1);
+  unlink(path);
+
+  std::string content(FileSize, '\0');
+  for (size_t i = 0; i < FileSize; i++)
+    content[i] = char('a' + i % 26);
+
+  EXPECT_EQ(write(fd, content.data(), content.size()), ssize_t(content.size()));
+
+  int h = -1;
+  int c = -1;
+  int s = -1;
+  ASSERT_TRUE(ConnectLoopback(h, c, s));
+
+  SocketPair pair(ch, exitEvent, config);
+  pair.Client = pair.CreateBIOSocket();
+
+  EXPECT_TRUE(pair.Client->Attach(s));
+  EXPECT_TRUE(pair.Client->Configure());
+
+  std::string received;
+  std::thread receiver(
+    [c, &received]()
+    {
+      char buffer[65536];
+      for (;;)
+      {
+        auto n = recv(c, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+          break;
+
+        received.append(buffer, size_t(n));
+      }
+    }
+  );
+
+  // The file is sent between in-memory writes
+  size_t length = FileSize - FileOffset;
+  EXPECT_EQ(pair.Client->WriteStr("head"), 4);
+  EXPECT_TRUE(pair.Client->SendFile(fd, FileOffset, length));
+  EXPECT_FALSE(pair.Client->TxQueue.IsEmpty());
+  EXPECT_EQ(pair.Client->WriteStr("tail"), 4);
+
+  // Descriptor is duplicated by SendFile()
+  close(fd);
+
+  while (pair.Client->TxQueue.IsEmpty() == false)
+    EXPECT_TRUE(pair.Client->Flush(1000));
+
+  shutdown(s, SHUT_WR);
+  receiver.join();
+
+  EXPECT_EQ(received.size(), length + 8);
+  EXPECT_TRUE(received == "head" + content.substr(FileOffset) + "tail");
+  EXPECT_TRUE(pair.Client->TxFiles.empty());
+
+  pair.Close(SocketPairCloseMode::Fast);
+  closesocket(c);
+  closesocket(h);
+}
+#endif
@@ -0,0 +1,126 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/Reactor.h>
+#include <Syncme/Sockets/SocketPair.h>
+
+#include "Loopback.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+
+using namespace Syncme;
+
+static const size_t NumPairs = 32;
+
+struct SharedReactorConfig : public Config
+{
+  bool Shared;
+
+  SharedReactorConfig(bool shared) : Shared(shared)
+  {
+  }
+
+  using Config::GetBool;
+
+  bool GetBool(const char* option, bool def) override
+  {
+    if (strcmp(option, "shared_reactor") == 0)
+      return Shared;
+
+    return Config::GetBool(option, def);
+  }
+};
+
+static size_t CountDescriptors()
+{
+  size_t n = 0;
+
+  DIR* dir = opendir("/proc/self/fd");
+  if (dir == nullptr)
+    return 0;
+
+  while (readdir(dir))
+    n++;
+
+  closedir(dir);
+  return n;
+}
+
+// Creates connected pairs, exchanges data over each of them and returns
+// the number of descriptors which were opened for the pairs
+static size_t RunPairs(bool shared)
+{
+  Logme::ID ch = CH;
+  HEvent exitEvent = CreateNotificationEvent();
+  ConfigPtr config = std::make_shared<SharedReactorConfig>(shared);
+
+  int h = CreateLoopbackListener();
+  EXPECT_NE(h, -1);
+
+  size_t before = CountDescriptors();
+
+  std::vector<std::unique_ptr<SocketPair>> pairs;
+  for (size_t i = 0; i < NumPairs; i++)
+  {
+    auto pair = std::make_unique<SocketPair>(ch, exitEvent, config);
+    EXPECT_TRUE(MakeLoopbackPair(*pair, h));
+
+    pairs.push_back(std::move(pair));
+  }
+
+  size_t opened = CountDescriptors() - before;
+
+  char buffer[64]{};
+  for (auto& pair : pairs)
+  {
+    EXPECT_EQ(pair->Client->WriteStr("ping"), 4);
+    EXPECT_EQ(pair->Server->Read(buffer, sizeof(buffer), 1000), 4);
+    EXPECT_EQ(memcmp(buffer, "ping", 4), 0);
+
+    EXPECT_EQ(pair->Server->WriteStr("pong"), 4);
+    EXPECT_EQ(pair->Client->Read(buffer, sizeof(buffer), 1000), 4);
+    EXPECT_EQ(memcmp(buffer, "pong", 4), 0);
+  }
+
+  // Nothing to read: the wait has to expire
+  EXPECT_EQ(pairs[0]->Client->Read(buffer, sizeof(buffer), 50), 0);
+  EXPECT_EQ(pairs[0]->Client->GetLastError().Code, SKT_ERROR::TIMEOUT);
+
+  // Exit event interrupts the wait
+  std::thread stopper([exitEvent]() { Sleep(50); SetEvent(exitEvent); });
+  EXPECT_EQ(pairs[1]->Client->Read(buffer, sizeof(buffer), 5000), -1);
+  stopper.join();
+
+  for (auto& pair : pairs)
+    pair->Close(SocketPairCloseMode::Fast);
+
+  pairs.clear();
+  closesocket(h);
+  return opened;
+}
+
+TEST(Sockets, shared_reactor)
+{
+  size_t plain = RunPairs(false);
+  size_t shared = RunPairs(true);
+
+  printf("%zu pairs: %zu descriptors, %zu with shared reactor (%zu used by reactor)\n"
+    , NumPairs
+    , plain
+    , shared
+    , Implementation::Reactor::GetDescriptors()
+  );
+
+  // Each socket uses its own epoll and eventfd in the default mode
+  EXPECT_GE(plain + Implementation::Reactor::GetDescriptors(), shared + NumPairs * 2 * 2);
+}
+#endif
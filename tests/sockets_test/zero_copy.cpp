@@ -0,0 +1,105 @@
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Syncme/Logger/Log.h>
+#include <Syncme/Sockets/API.h>
+#include <Syncme/Sockets/SocketPair.h>
+#include <Syncme/TickCount.h>
+
+#include "Loopback.h"
+
+using namespace Syncme;
+
+static const size_t TransferSize = 128ULL * 1024 * 1024;
+static const size_t ChunkSize = 64ULL * 1024;
+
+// Sends TransferSize bytes over loopback and receives them by Read()
+// with a copy or by ReadBuffer(). Returns throughput in MiB/s
+static double RunTransfer(bool zeroCopy)
+{
+  Logme::ID ch = CH;
+  HEvent exitEvent = CreateNotificationEvent();
+  ConfigPtr config = std::make_shared<Config>();
+
+  int h = -1;
+  int c = -1;
+  int s = -1;
+  EXPECT_TRUE(ConnectLoopback(h, c, s));
+
+  SocketPair pair(ch, exitEvent, config);
+  pair.Client = pair.CreateBIOSocket();
+  EXPECT_TRUE(pair.Client->Attach(s));
+  EXPECT_TRUE(pair.Client->Configure());
+
+  std::thread sender(
+    [c]()
+    {
+      std::vector<char> chunk(ChunkSize, 'x');
+      for (size_t sent = 0; sent < TransferSize;)
+      {
+        auto n = send(c, chunk.data(), chunk.size(), MSG_NOSIGNAL);
+        if (n <= 0)
+          break;
+
+        sent += size_t(n);
+      }
+
+      closesocket(c);
+    }
+  );
+
+  uint64_t t0 = GetTimeInMicrosec();
+  size_t received = 0;
+
+  if (zeroCopy)
+  {
+    for (;;)
+    {
+      auto b = pair.Client->ReadBuffer(5000);
+      if (b == nullptr)
+        break;
+
+      received += b->size();
+      pair.Client->ReleaseBuffer(b);
+    }
+  }
+  else
+  {
+    std::vector<char> buffer(Sockets::IO::BUFFER_SIZE);
+    for (;;)
+    {
+      int n = pair.Client->Read(buffer, 5000);
+      if (n <= 0)
+        break;
+
+      received += size_t(n);
+    }
+  }
+
+  uint64_t spent = GetTimeInMicrosec() - t0;
+
+  EXPECT_EQ(received, TransferSize);
+  EXPECT_EQ(pair.Client->GetLastError().Code, SKT_ERROR::GRACEFUL_DISCONNECT);
+
+  // Sender fails if the data was not received
+  pair.Close(SocketPairCloseMode::Fast);
+  sender.join();
+  closesocket(h);
+
+  return double(received) / (1024 * 1024) / (double(spent ? spent : 1) / 1000000);
+}
+
+TEST(Sockets, zero_copy_throughput)
+{
+  double copy = RunTransfer(false);
+  double zero = RunTransfer(true);
+
+  printf("\n=== loopback, %zu MiB ===\n", TransferSize / (1024 * 1024));
+  printf("Read()       : %.0f MiB/s\n", copy);
+  printf("ReadBuffer() : %.0f MiB/s\n", zero);
+}
@@ -0,0 +1,257 @@
+#include <atomic>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sync.h>
+#include <Syncme/TaskQueue.h>
+#include <Syncme/TickCount.h>
+
+using namespace Syncme;
+using namespace Syncme::Task;
+
+TEST(TaskQueue, schedule)
+{
+  Queue queue(4);
+
+  std::atomic<int> executed = 0;
+  std::vector<ItemPtr> items;
+
+  for (int i = 0; i < 1000; i++)
+    items.push_back(queue.Schedule([&executed]() { executed++; }, "inc"));
+
+  for (auto& item : items)
+    item->WaitForCompletion();
+
+  EXPECT_EQ(executed, 1000);
+
+  HEvent h = items.back()->GetCompletedEvent();
+  EXPECT_EQ(WaitForSingleObject(h, 0), WAIT_RESULT::OBJECT_0);
+}
+
+TEST(TaskQueue, cancel)
+{
+  Queue queue;
+
+  HEvent release = CreateNotificationEvent();
+  ItemPtr blocker = queue.Schedule([release]() { WaitForSingleObject(release); }, "block");
+
+  bool executed = false;
+  ItemPtr item = queue.Schedule([&executed]() { executed = true; }, "cancelled");
+  HEvent h = item->GetCompletedEvent();
+
+  EXPECT_TRUE(queue.Cancel(item));
+  EXPECT_FALSE(queue.Cancel(item));
+  EXPECT_EQ(WaitForSingleObject(h, 0), WAIT_RESULT::OBJECT_0);
+
+  SetEvent(release);
+  blocker->WaitForCompletion();
+
+  // Items left in the queue are cancelled by Stop()
+  queue.Schedule([release]() { WaitForSingleObject(release); }, "last");
+  queue.Stop();
+
+  EXPECT_FALSE(executed);
+}
+
+// Dispatch throughput with 1 and 4 workers
+TEST(TaskQueue, throughput)
+{
+  const int COUNT = 200000;
+
+  for (size_t workers : {1, 4})
+  {
+    Queue queue(workers);
+    std::atomic<int> executed = 0;
+    HEvent done = CreateNotificationEvent();
+
+    uint64_t t0 = GetTimeInMicrosec();
+
+    for (int i = 0; i < COUNT; i++)
+    {
+      queue.Schedule(
+        [&executed, done]()
+        {
+          if (++executed == COUNT)
+            SetEvent(done);
+        }
+        , ""
+      );
+    }
+
+    ASSERT_EQ(WaitForSingleObject(done, 10000), WAIT_RESULT::OBJECT_0);
+
+    uint64_t spent = GetTimeInMicrosec() - t0;
+    printf("workers=%zu: %i items in %llu us\n", workers, COUNT, (unsigned long long)spent);
+  }
+}
+
+// Items of a strand are executed in order and do not overlap while
+// strands run in parallel
+TEST(TaskQueue, strands)
+{
+  const int STRANDS = 16;
+  const int ITEMS = 500;
+
+  Queue queue(4);
+
+  std::atomic<int> running[STRANDS] = {};
+  std::vector<int> seq[STRANDS];
+  std::atomic<int> overlaps = 0;
+
+  StrandPtr handle = queue.CreateStrand();
+  std::vector<int> handleSeq;
+
+  std::vector<ItemPtr> items;
+  for (int i = 0; i < ITEMS; i++)
+  {
+    for (int s = 0; s < STRANDS; s++)
+    {
+      std::string id = "strand" + std::to_string(s);
+
+      items.push_back(
+        queue.ScheduleOrdered(
+          [&, s, i]()
+          {
+            if (running[s]++)
+              overlaps++;
+
+            seq[s].push_back(i);
+            running[s]--;
+          }
+          , id.c_str()
+        )
+      );
+    }
+
+    items.push_back(handle->Schedule([&handleSeq, i]() { handleSeq.push_back(i); }));
+  }
+
+  for (auto& item : items)
+    item->WaitForCompletion();
+
+  EXPECT_EQ(overlaps, 0);
+
+  for (int s = 0; s < STRANDS; s++)
+  {
+    ASSERT_EQ(seq[s].size(), size_t(ITEMS));
+
+    for (int i = 0; i < ITEMS; i++)
+      EXPECT_EQ(seq[s][i], i);
+  }
+
+  ASSERT_EQ(handleSeq.size(), size_t(ITEMS));
+  for (int i = 0; i < ITEMS; i++)
+    EXPECT_EQ(handleSeq[i], i);
+}
+
+TEST(TaskQueue, delayed)
+{
+  Queue queue(2);
+
+  uint64_t t0 = GetTimeInMillisec();
+  std::atomic<uint64_t> executedAt = 0;
+
+  ItemPtr item = queue.ScheduleAfter(50, [&executedAt]() { executedAt = GetTimeInMillisec(); });
+  bool cancelledRun = false;
+  ItemPtr cancelled = queue.ScheduleAfter(20, [&cancelledRun]() { cancelledRun = true; });
+
+  EXPECT_TRUE(queue.Cancel(cancelled));
+
+  std::atomic<int> ticks = 0;
+  ItemPtr periodic = queue.ScheduleEvery(10, [&ticks]() { ticks++; });
+
+  item->WaitForCompletion();
+  EXPECT_GE(executedAt - t0, 50);
+
+  while (ticks < 3)
+    Sleep(5);
+
+  EXPECT_TRUE(queue.Cancel(periodic));
+  periodic->WaitForCompletion();
+
+  int n = ticks;
+  Sleep(50);
+  EXPECT_EQ(ticks, n);
+  EXPECT_FALSE(cancelledRun);
+}
+
+// Strand which outlives its queue cancels new items
+TEST(TaskQueue, strand_detached)
+{
+  StrandPtr strand;
+
+  if (true)
+  {
+    Queue queue;
+    strand = queue.CreateStrand();
+
+    ItemPtr item = strand->Schedule([]() {});
+    item->WaitForCompletion();
+    EXPECT_EQ(item->State, uint32_t(ITEM_STATE::COMPLETED));
+  }
+
+  bool executed = false;
+  ItemPtr item = strand->Schedule([&executed]() { executed = true; });
+  EXPECT_EQ(item->State, uint32_t(ITEM_STATE::CANCELLED));
+  EXPECT_FALSE(executed);
+}
+
+// Cancelled items do not wait in the queue till their due time
+TEST(TaskQueue, delayed_cancel)
+{
+  Queue queue;
+
+  auto state = std::make_shared<int>(0);
+  std::vector<std::weak_ptr<Item>> cancelled;
+
+  for (int i = 0; i < 1000; i++)
+  {
+    ItemPtr item = queue.ScheduleAfter(3600 * 1000, [state]() { (*state)++; });
+    EXPECT_TRUE(queue.Cancel(item));
+    cancelled.push_back(item);
+  }
+
+  EXPECT_EQ(state.use_count(), 1);
+
+  for (auto& item : cancelled)
+    EXPECT_TRUE(item.expired());
+}
+
+TEST(TaskQueue, coalesced)
+{
+  Queue queue;
+
+  HEvent release = CreateNotificationEvent();
+  queue.Schedule([release]() { WaitForSingleObject(release); }, "block");
+
+  std::atomic<int> executed = 0;
+  int value = 0;
+
+  ItemPtr item;
+  for (int i = 1; i <= 100; i++)
+    item = queue.ScheduleCoalesced("flush", [&executed, &value, i]() { executed++; value = i; });
+
+  bool cancelledRun = false;
+  queue.ScheduleCoalesced("cancelled", [&cancelledRun]() { cancelledRun = true; });
+  EXPECT_TRUE(queue.Cancel(std::string("cancelled")));
+
+  EXPECT_EQ(queue.GetMerged(), 99);
+
+  SetEvent(release);
+  item->WaitForCompletion();
+
+  EXPECT_EQ(executed, 1);
+  EXPECT_EQ(value, 100);
+
+  // The item is started, so the next call schedules a new one
+  ItemPtr next = queue.ScheduleCoalesced("flush", [&executed]() { executed++; }, COALESCE_MODE::KEEP);
+  EXPECT_NE(next, item);
+  next->WaitForCompletion();
+
+  EXPECT_EQ(executed, 2);
+  EXPECT_FALSE(cancelledRun);
+}
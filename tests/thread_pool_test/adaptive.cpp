@@ -0,0 +1,122 @@
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+static AdaptiveSample Sample(uint64_t completed, uint64_t delay, size_t busy)
+{
+  AdaptiveSample s{};
+  s.Interval = 100;
+  s.Completed = completed;
+  s.QueueDelay = delay;
+  s.PeakBusy = busy;
+  return s;
+}
+
+TEST(Adaptive, controller)
+{
+  AdaptiveConfig config;
+  config.Enabled = true;
+  config.MinThreads = 2;
+  config.MaxThreads = 32;
+  config.TargetQueueDelay = 1000;
+
+  AdaptiveController c(config);
+  EXPECT_EQ(c.GetLimit(), 2u);
+
+  // Queueing with growing throughput. Step is doubled
+  size_t limits[] = {3, 4, 6, 10};
+  for (size_t i = 0; i < 4; i++)
+  {
+    auto d = c.Update(Sample(100 * (i + 1), 5000, c.GetLimit()));
+    EXPECT_EQ(d.Reason, ADAPT_REASON::QUEUEING);
+    EXPECT_EQ(d.Limit, limits[i]);
+  }
+
+  // Last growth decreased throughput. It is cancelled
+  auto d = c.Update(Sample(200, 5000, 10));
+  EXPECT_EQ(d.Reason, ADAPT_REASON::THROUGHPUT_DROP);
+  EXPECT_EQ(d.Limit, 6u);
+
+  d = c.Update(Sample(400, 100, 6));
+  EXPECT_EQ(d.Reason, ADAPT_REASON::STABLE);
+  EXPECT_EQ(d.Limit, 6u);
+
+  d = c.Update(Sample(400, 100, 2));
+  EXPECT_EQ(d.Reason, ADAPT_REASON::UNDERUSED);
+  EXPECT_EQ(d.Limit, 5u);
+
+  for (int i = 0; i < 10; i++)
+    d = c.Update(Sample(0, 0, 0));
+
+  EXPECT_EQ(d.Reason, ADAPT_REASON::IDLE);
+  EXPECT_EQ(d.Limit, 2u);
+  EXPECT_EQ(c.GetTrace().size(), 17u);
+}
+
+TEST(Adaptive, pool)
+{
+  Pool tpool;
+
+  std::atomic<int> decisions{};
+
+  AdaptiveConfig config;
+  config.Enabled = true;
+  config.MinThreads = 1;
+  config.MaxThreads = 16;
+  config.Interval = 20;
+  config.TargetQueueDelay = 1000;
+  config.OnDecision = [&decisions](const AdaptiveDecision&) { decisions++; };
+  tpool.SetAdaptive(config);
+
+  EXPECT_EQ(tpool.GetThreadLimit(), 1u);
+
+  // Tasks sleep, so more threads give more throughput
+  std::atomic<bool> stop{};
+  std::vector<std::thread> producers;
+
+  for (int i = 0; i < 16; i++)
+  {
+    producers.emplace_back(
+      [&]()
+      {
+        while (!stop)
+          tpool.Run([]() { Sleep(5); });
+      }
+    );
+  }
+
+  Sleep(1000);
+  size_t peak = tpool.GetThreadLimit();
+
+  stop = true;
+  for (auto& t : producers)
+    t.join();
+
+  EXPECT_GT(peak, 4u);
+  EXPECT_LE(peak, 16u);
+
+  // Short tasks from one producer do not need many threads
+  for (int i = 0; i < 200; i++)
+  {
+    HEvent h = tpool.Run([]() {});
+    WaitForSingleObject(h);
+    Sleep(1);
+  }
+
+  EXPECT_LT(tpool.GetThreadLimit(), peak);
+  EXPECT_GT(decisions, 0);
+
+  auto trace = tpool.GetAdaptiveTrace();
+  EXPECT_FALSE(trace.empty());
+
+  tpool.Stop();
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+#include <Syncme/Affinity.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/NumaPool.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+TEST(Pool, affinity_per_core)
+{
+  CpuSet allowed = GetCurrentThreadAffinity();
+  if (allowed.empty())
+    GTEST_SKIP() << "thread affinity is not supported";
+
+  uint32_t cpu = allowed.back();
+
+  Pool tpool;
+  tpool.SetMaxThreads(1);
+  tpool.SetAffinity(CpuSet{cpu}, AFFINITY_MODE::PER_CORE);
+
+  std::atomic<int> mismatch{};
+  for (int i = 0; i < 16; i++)
+  {
+    HEvent h = tpool.Run(
+      [cpu, &mismatch]()
+      {
+        CpuSet cpus = GetCurrentThreadAffinity();
+        if (cpus.size() != 1 || cpus[0] != cpu || GetCurrentCpu() != cpu)
+          mismatch++;
+      }
+    );
+
+    ASSERT_NE(h, nullptr);
+    EXPECT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+  }
+
+  EXPECT_EQ(mismatch, 0);
+  tpool.Stop();
+}
+
+TEST(Pool, numa_pool)
+{
+  EXPECT_GE(GetNumaNodeCount(), 1u);
+
+  // Nodes are indexed by system ids. Some of them can have no CPUs
+  uint32_t cpu = GetCurrentCpu();
+  CpuSet local = GetNumaNodeCpus(GetNumaNodeOfCpu(cpu));
+  EXPECT_NE(std::find(local.begin(), local.end(), cpu), local.end());
+
+  NumaPool pools;
+  ASSERT_EQ(pools.GetNodeCount(), GetNumaNodeCount());
+
+  std::atomic<int> executed{};
+  for (size_t node = 0; node < pools.GetNodeCount(); node++)
+  {
+    HEvent h = pools.Run(node, [&executed]() { executed++; });
+    ASSERT_NE(h, nullptr);
+    EXPECT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+  }
+
+  HEvent h = pools.Run([&executed]() { executed++; });
+  ASSERT_NE(h, nullptr);
+  EXPECT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+
+  EXPECT_EQ(executed, int(pools.GetNodeCount() + 1));
+  pools.Stop();
+}
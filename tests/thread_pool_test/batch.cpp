@@ -0,0 +1,63 @@
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+TEST(Pool, batch)
+{
+  Pool tpool;
+  std::atomic<int> calls{};
+
+  std::vector<TCallback> batch;
+  for (int i = 0; i < 64; i++)
+    batch.push_back([&calls]() { calls++; });
+
+  HEvent completion;
+  size_t n = tpool.RunBatch(batch, &completion);
+  EXPECT_EQ(n, batch.size());
+
+  auto rc = WaitForSingleObject(completion, 5000);
+  EXPECT_EQ(rc, WAIT_RESULT::OBJECT_0);
+  EXPECT_EQ(calls, 64);
+
+  tpool.Stop();
+}
+
+TEST(Pool, batch_overflow_fail)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(4);
+  tpool.SetOverflowMode(OVERFLOW_MODE::FAIL);
+
+  HEvent release = CreateNotificationEvent();
+  std::atomic<int> calls{};
+
+  std::vector<TCallback> batch;
+  for (int i = 0; i < 16; i++)
+  {
+    batch.push_back(
+      [&calls, release]()
+      {
+        WaitForSingleObject(release);
+        calls++;
+      }
+    );
+  }
+
+  HEvent completion;
+  size_t n = tpool.RunBatch(batch, &completion);
+  EXPECT_EQ(n, 4);
+
+  SetEvent(release);
+
+  auto rc = WaitForSingleObject(completion, 5000);
+  EXPECT_EQ(rc, WAIT_RESULT::OBJECT_0);
+  EXPECT_EQ(calls, (int)n);
+
+  tpool.Stop();
+}
@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Counter.h>
+#include <Syncme/ThreadPool/Pool.h>
+#include <Syncme/TickCount.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+const int CHURN_ROUNDS = 100;
+const int CHURN_THREADS = 100;
+
+static bool WaitForThreadsTotalBelow(uint64_t limit, size_t timeout)
+{
+  uint64_t t0 = GetTimeInMillisec();
+  for (;;)
+  {
+    if (GetThreadsTotal() <= limit)
+      return true;
+
+    if (GetTimeInMillisec() - t0 >= timeout)
+      return false;
+
+    Sleep(1);
+  }
+}
+
+// Creates 10k threads in total. Each round makes all threads busy and
+// then waits till idle workers are expired
+TEST(Pool, churn)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(CHURN_THREADS);
+  tpool.SetMaxUnusedThreads(0);
+  tpool.SetMaxIdleTime(1);
+
+  uint64_t created = GetCreateInvoke();
+  uint64_t stopped = GetThreadsStopped();
+
+  for (int round = 0; round < CHURN_ROUNDS; round++)
+  {
+    HEvent release = CreateNotificationEvent();
+
+    std::vector<TCallback> batch;
+    for (int i = 0; i < CHURN_THREADS; i++)
+      batch.push_back([release]() { WaitForSingleObject(release); });
+
+    HEvent completion;
+    ASSERT_EQ(tpool.RunBatch(batch, &completion), batch.size());
+
+    SetEvent(release);
+    ASSERT_EQ(WaitForSingleObject(completion, 5000), WAIT_RESULT::OBJECT_0);
+
+    // The last worker which handles the timer can not stop itself
+    ASSERT_TRUE(WaitForThreadsTotalBelow(1, 5000));
+  }
+
+  tpool.StopUnused();
+  EXPECT_EQ(GetThreadsTotal(), 0);
+
+  created = GetCreateInvoke() - created;
+  stopped = GetThreadsStopped() - stopped;
+
+  EXPECT_GE(created, uint64_t(CHURN_ROUNDS * (CHURN_THREADS - 1)));
+  EXPECT_EQ(created, stopped);
+
+  tpool.Stop();
+}
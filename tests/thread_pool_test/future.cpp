@@ -0,0 +1,113 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+TEST(Future, submit)
+{
+  Pool tpool;
+
+  Future<int> f = tpool.Submit([]() { return 42; });
+  EXPECT_EQ(f.Get(), 42);
+
+  Future<void> v = tpool.Submit([]() {});
+  EXPECT_EQ(v.Wait(5000), WAIT_RESULT::OBJECT_0);
+
+  tpool.Stop();
+}
+
+TEST(Future, then)
+{
+  Pool tpool;
+
+  auto f = tpool.Submit([]() { return 20; })
+    .Then([](int v) { return v + 1; })
+    .Then([](int v) { return std::to_string(v * 2); });
+
+  EXPECT_EQ(f.Get(), "42");
+
+  auto e = tpool.Submit([]() -> int { throw std::runtime_error("failed"); })
+    .Then([](int v) { return v + 1; });
+
+  EXPECT_THROW(e.Get(), std::runtime_error);
+  tpool.Stop();
+}
+
+TEST(Future, when_all_any)
+{
+  Pool tpool;
+  HEvent release = CreateNotificationEvent();
+
+  std::vector<Future<int>> futures;
+  for (int i = 0; i < 8; i++)
+    futures.push_back(tpool.Submit([i]() { return i; }));
+
+  futures.push_back(
+    tpool.Submit(
+      [release]()
+      {
+        WaitForSingleObject(release);
+        return 8;
+      }
+    )
+  );
+
+  auto any = WhenAny(futures);
+  EXPECT_LT(any.Get(), 8u);
+
+  auto all = WhenAll(futures);
+  EXPECT_EQ(all.Wait(100), WAIT_RESULT::TIMEOUT);
+
+  SetEvent(release);
+
+  std::vector<int> values = all.Get();
+  ASSERT_EQ(values.size(), 9u);
+
+  for (int i = 0; i < 9; i++)
+    EXPECT_EQ(values[i], i);
+
+  // Nothing to wait for
+  auto none = WhenAny(std::vector<Future<int>>());
+  EXPECT_TRUE(none.IsReady());
+  EXPECT_THROW(none.Get(), std::invalid_argument);
+
+  // Future without state
+  Future<int> empty;
+  EXPECT_EQ(empty.Wait(0), WAIT_RESULT::FAILED);
+  EXPECT_THROW(empty.Get(), std::future_error);
+
+  tpool.Stop();
+}
+
+TEST(Future, wait_multiple)
+{
+  Pool tpool;
+  HEvent release = CreateNotificationEvent();
+
+  Future<int> f1 = tpool.Submit(
+    [release]()
+    {
+      WaitForSingleObject(release);
+      return 1;
+    }
+  );
+  Future<int> f2 = tpool.Submit([]() { return 2; });
+
+  EventArray ev(f1, f2);
+  auto rc = WaitForMultipleObjects(ev, false, 5000);
+  EXPECT_EQ(rc, WAIT_RESULT::OBJECT_1);
+
+  SetEvent(release);
+
+  rc = WaitForMultipleObjects(ev, true, 5000);
+  EXPECT_NE(rc, WAIT_RESULT::TIMEOUT);
+  EXPECT_EQ(f1.Get() + f2.Get(), 3);
+
+  tpool.Stop();
+}
@@ -0,0 +1,131 @@
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Counter.h>
+#include <Syncme/ThreadPool/Pool.h>
+#include <Syncme/TickCount.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+const int KEYED_KEYS = 8;
+const int KEYED_TASKS = 200;
+
+// Tasks of a key are executed in order of submission and never overlap
+TEST(Pool, keyed_order)
+{
+  Pool tpool;
+
+  std::atomic<int> running[KEYED_KEYS] = {};
+  std::vector<int> seq[KEYED_KEYS];
+  std::atomic<int> overlaps = 0;
+
+  std::vector<HEvent> handles;
+  for (int i = 0; i < KEYED_TASKS; i++)
+  {
+    for (int key = 0; key < KEYED_KEYS; key++)
+    {
+      HEvent h = tpool.Run(
+        uint64_t(key)
+        , [&, key, i]()
+        {
+          if (running[key]++)
+            overlaps++;
+
+          seq[key].push_back(i);
+          running[key]--;
+        }
+      );
+
+      ASSERT_NE(h, nullptr);
+      handles.push_back(h);
+    }
+  }
+
+  for (auto& h : handles)
+    ASSERT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+
+  EXPECT_EQ(overlaps, 0);
+
+  for (int key = 0; key < KEYED_KEYS; key++)
+  {
+    ASSERT_EQ(seq[key].size(), size_t(KEYED_TASKS));
+
+    for (int i = 0; i < KEYED_TASKS; i++)
+      EXPECT_EQ(seq[key][i], i);
+  }
+
+  tpool.Stop();
+}
+
+const int LOCALITY_KEYS = 16;
+const int LOCALITY_TASKS = 500;
+const size_t LOCALITY_STATE = 64 * 1024;
+
+// Each task reads the state of its key. With keyed submission the state
+// stays in the cache of the worker which handles the key
+static uint64_t RunLocality(bool keyed)
+{
+  Pool tpool;
+
+  std::vector<std::vector<uint64_t>> state(LOCALITY_KEYS);
+  for (auto& s : state)
+    s.assign(LOCALITY_STATE / sizeof(uint64_t), 1);
+
+  std::atomic<uint64_t> sum = 0;
+  std::vector<HEvent> handles;
+
+  uint64_t t0 = GetTimeInMicrosec();
+
+  for (int i = 0; i < LOCALITY_TASKS; i++)
+  {
+    for (int key = 0; key < LOCALITY_KEYS; key++)
+    {
+      auto work = [&sum, &s = state[key]]()
+      {
+        uint64_t v = 0;
+        for (uint64_t x : s)
+          v += x;
+
+        sum += v;
+      };
+
+      handles.push_back(keyed ? tpool.Run(uint64_t(key), work) : tpool.Run(work));
+    }
+  }
+
+  for (auto& h : handles)
+    WaitForSingleObject(h, 10000);
+
+  uint64_t spent = GetTimeInMicrosec() - t0;
+
+  EXPECT_EQ(sum, uint64_t(LOCALITY_KEYS) * LOCALITY_TASKS * (LOCALITY_STATE / sizeof(uint64_t)));
+
+  tpool.Stop();
+  return spent;
+}
+
+TEST(Pool, keyed_locality)
+{
+  uint64_t affine = GetAffineInvoke();
+  uint64_t steal = GetAffineSteal();
+
+  uint64_t plain = RunLocality(false);
+  uint64_t keyed = RunLocality(true);
+
+  printf("\n=== %i keys x %i tasks, %zu KiB state per key ===\n"
+    , LOCALITY_KEYS
+    , LOCALITY_TASKS
+    , LOCALITY_STATE / 1024
+  );
+  printf("Run()      : %llu us\n", (unsigned long long)plain);
+  printf("Run(key)   : %llu us\n", (unsigned long long)keyed);
+  printf("Home/steal : %llu/%llu\n"
+    , (unsigned long long)(GetAffineInvoke() - affine)
+    , (unsigned long long)(GetAffineSteal() - steal)
+  );
+}
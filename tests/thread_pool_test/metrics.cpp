@@ -0,0 +1,78 @@
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+#include <Syncme/Histogram.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+TEST(Histogram, percentile)
+{
+  Histogram h;
+  for (uint64_t v = 1; v <= 10000; v++)
+    h.Record(v);
+
+  auto s = h.Snapshot();
+  EXPECT_EQ(s.Count, 10000u);
+  EXPECT_EQ(s.Min, 1u);
+  EXPECT_EQ(s.Max, 10000u);
+  EXPECT_DOUBLE_EQ(s.Mean(), 5000.5);
+
+  // Relative error is below 1/32
+  EXPECT_NEAR(double(s.Percentile(50)), 5000.0, 5000.0 / 32);
+  EXPECT_NEAR(double(s.Percentile(99)), 9900.0, 9900.0 / 32);
+  EXPECT_NEAR(double(s.Percentile(99.9)), 9990.0, 9990.0 / 32);
+  EXPECT_EQ(s.Percentile(100), 10000u);
+
+  for (size_t i = 0; i < Histogram::BUCKETS; i++)
+    EXPECT_EQ(Histogram::GetBucket(Histogram::GetBucketLimit(i)), i);
+
+  EXPECT_EQ(Histogram::GetBucket(UINT64_MAX), Histogram::BUCKETS - 1);
+
+  s = h.SnapshotAndReset();
+  EXPECT_EQ(s.Count, 10000u);
+  EXPECT_EQ(h.Snapshot().Count, 0u);
+}
+
+TEST(Pool, metrics)
+{
+  Pool tpool;
+
+  RunOptions tagged;
+  tagged.Tag = "sleep";
+
+  for (int i = 0; i < 20; i++)
+  {
+    HEvent h = tpool.Run([]() { Sleep(2); }, tagged);
+    ASSERT_NE(h, nullptr);
+    EXPECT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+  }
+
+  HEvent h = tpool.Run([]() {});
+  ASSERT_NE(h, nullptr);
+  EXPECT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+
+  auto tags = tpool.GetTags();
+  ASSERT_EQ(tags.size(), 1u);
+  EXPECT_EQ(tags[0], "sleep");
+
+  auto tag = tpool.GetTagMetrics("sleep", true);
+  EXPECT_EQ(tag.QueueDelay.Count, 20u);
+  EXPECT_EQ(tag.RunOverhead.Count, 20u);
+  EXPECT_EQ(tag.RunTime.Count, 20u);
+  EXPECT_GE(tag.RunTime.Percentile(50), 2000u);
+
+  EXPECT_EQ(tpool.GetTagMetrics("sleep").RunTime.Count, 0u);
+
+  auto all = tpool.GetMetrics();
+  EXPECT_EQ(all.QueueDelay.Count, 21u);
+  EXPECT_EQ(all.RunOverhead.Count, 21u);
+
+  tpool.Stop();
+
+  // Run time is recorded when a worker becomes idle
+  EXPECT_EQ(tpool.GetMetrics().RunTime.Count, 21u);
+}
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+static uint64_t Checksum(const std::vector<uint8_t>& data, size_t begin, size_t end)
+{
+  uint64_t sum = 0;
+  for (size_t i = begin; i < end; i++)
+    sum = sum * 31 + data[i];
+
+  return sum;
+}
+
+static uint64_t Combine(uint64_t a, uint64_t b)
+{
+  return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+}
+
+TEST(Parallel, for_each)
+{
+  Pool tpool;
+
+  std::vector<std::atomic<int>> hits(100000);
+  tpool.ParallelFor(
+    0
+    , hits.size()
+    , 0
+    , [&hits](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; i++)
+        hits[i]++;
+    }
+  );
+
+  for (auto& h : hits)
+    ASSERT_EQ(h, 1);
+
+  // Empty range and a range smaller than grain
+  tpool.ParallelFor(5, 5, 0, [](size_t, size_t) { FAIL(); });
+
+  int calls = 0;
+  tpool.ParallelFor(0, 3, 100, [&calls](size_t begin, size_t end) { calls++; EXPECT_EQ(end - begin, 3u); });
+  EXPECT_EQ(calls, 1);
+
+  EXPECT_THROW(
+    tpool.ParallelFor(0, 1000, 1, [](size_t begin, size_t) { if (begin == 500) throw std::runtime_error("x"); })
+    , std::runtime_error
+  );
+
+  tpool.Stop();
+}
+
+TEST(Parallel, reduce)
+{
+  Pool tpool;
+
+  uint64_t sum = tpool.ParallelReduce(
+    1
+    , 1000001
+    , 0
+    , uint64_t(0)
+    , [](size_t begin, size_t end)
+    {
+      uint64_t s = 0;
+      for (size_t i = begin; i < end; i++)
+        s += i;
+
+      return s;
+    }
+    , [](uint64_t a, uint64_t b) { return a + b; }
+  );
+
+  EXPECT_EQ(sum, 500000500000ULL);
+  tpool.Stop();
+}
+
+TEST(Parallel, benchmark)
+{
+  using namespace std::chrono;
+
+  const size_t SIZE = 64 * 1024 * 1024;
+  const size_t GRAIN = 256 * 1024;
+
+  std::vector<uint8_t> data(SIZE);
+  for (size_t i = 0; i < SIZE; i++)
+    data[i] = uint8_t(i * 7);
+
+  Pool tpool;
+  size_t chunks = SIZE / GRAIN;
+
+  // Serial loop over the same chunks
+  auto t0 = steady_clock::now();
+  uint64_t serial = 0;
+  for (size_t i = 0; i < chunks; i++)
+    serial = Combine(serial, Checksum(data, i * GRAIN, (i + 1) * GRAIN));
+
+  auto t1 = steady_clock::now();
+
+  // Hand-rolled Run() per chunk and wait for each handle
+  std::vector<uint64_t> partial(chunks);
+  std::vector<HEvent> handles;
+  for (size_t i = 0; i < chunks; i++)
+  {
+    handles.push_back(
+      tpool.Run([&, i]() { partial[i] = Checksum(data, i * GRAIN, (i + 1) * GRAIN); })
+    );
+  }
+
+  for (auto& h : handles)
+    WaitForSingleObject(h);
+
+  uint64_t manual = 0;
+  for (auto p : partial)
+    manual = Combine(manual, p);
+
+  auto t2 = steady_clock::now();
+
+  uint64_t reduced = tpool.ParallelReduce(
+    0
+    , SIZE
+    , GRAIN
+    , uint64_t(0)
+    , [&data](size_t begin, size_t end) { return Checksum(data, begin, end); }
+    , Combine
+  );
+
+  auto t3 = steady_clock::now();
+
+  EXPECT_EQ(serial, manual);
+  EXPECT_EQ(serial, reduced);
+
+  printf("\n=== Checksum of %zu MiB, %zu chunks ===\n", SIZE >> 20, chunks);
+  printf("Serial loop    : %lld us\n", (long long)duration_cast<microseconds>(t1 - t0).count());
+  printf("Run() + wait   : %lld us\n", (long long)duration_cast<microseconds>(t2 - t1).count());
+  printf("ParallelReduce : %lld us\n", (long long)duration_cast<microseconds>(t3 - t2).count());
+
+  tpool.Stop();
+}
@@ -9,6 +9,7 @@
 #include <gtest/gtest.h>
 
 #include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Counter.h>
 #include <Syncme/ThreadPool/Pool.h>
 
 using namespace Syncme;
@@ -129,4 +130,77 @@ static void RunTest()
 TEST(Pool, performance)
 {
   RunTest();
-}
\ No newline at end of file
+}
+
+constexpr int kInvokeIterations = 20000;
+
+static uint64_t ElapsedMicroseconds(std::chrono::steady_clock::time_point t0)
+{
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+}
+
+// Average time of Run() + wait for completion when an idle worker
+// is available (SlowInvoke path)
+static void MeasureSlowInvoke()
+{
+  Pool pool;
+  WaitForSingleObject(pool.Run([]() {}));
+
+  uint64_t slow0 = GetSlowInvoke();
+  auto t0 = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < kInvokeIterations; ++i)
+  {
+    HEvent h = pool.Run([]() {});
+    WaitForSingleObject(h);
+  }
+
+  uint64_t elapsed = ElapsedMicroseconds(t0);
+  pool.Stop();
+
+  std::cout << "SlowInvoke    : count = " << (GetSlowInvoke() - slow0)
+    << ", avg latency = " << double(elapsed) / kInvokeIterations << " us\n";
+}
+
+// Average time per task when the only worker takes queued tasks
+// itself after completion of the previous one (DirectInvoke path)
+static void MeasureDirectInvoke()
+{
+  Pool pool;
+  pool.SetMaxThreads(1);
+
+  std::atomic<int> done{};
+  uint64_t direct0 = GetDirectInvoke();
+  auto t0 = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 2; ++p)
+  {
+    producers.emplace_back(
+      [&pool, &done]()
+      {
+        for (int i = 0; i < kInvokeIterations / 2; ++i)
+          pool.Run([&done]() { done++; });
+      }
+    );
+  }
+
+  for (auto& t : producers)
+    t.join();
+
+  while (done < kInvokeIterations)
+    std::this_thread::yield();
+
+  uint64_t elapsed = ElapsedMicroseconds(t0);
+  pool.Stop();
+
+  std::cout << "DirectInvoke  : count = " << (GetDirectInvoke() - direct0)
+    << ", avg latency = " << double(elapsed) / kInvokeIterations << " us\n";
+}
+
+TEST(Pool, invoke_latency)
+{
+  MeasureSlowInvoke();
+  MeasureDirectInvoke();
+}
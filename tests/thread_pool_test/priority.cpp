@@ -0,0 +1,138 @@
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+static void WaitSubmitted(Pool& tpool, PRIORITY lane, uint64_t n)
+{
+  while (tpool.GetLaneStats(lane).Submitted < n)
+    Sleep(1);
+}
+
+TEST(Pool, priority_order)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(1);
+
+  HEvent release = CreateNotificationEvent();
+  HEvent h = tpool.Run([release]() { WaitForSingleObject(release); });
+  ASSERT_NE(h, nullptr);
+
+  std::mutex lock;
+  std::vector<PRIORITY> order;
+
+  auto submit = [&](PRIORITY lane)
+  {
+    RunOptions options;
+    options.Priority = lane;
+
+    HEvent e = tpool.Run(
+      [&, lane]()
+      {
+        std::lock_guard guard(lock);
+        order.push_back(lane);
+      }
+      , options
+    );
+
+    EXPECT_NE(e, nullptr);
+  };
+
+  // Both callers wait for the only worker
+  std::thread low(submit, PRIORITY::LOW);
+  WaitSubmitted(tpool, PRIORITY::LOW, 1);
+
+  std::thread high(submit, PRIORITY::HIGH);
+  WaitSubmitted(tpool, PRIORITY::HIGH, 1);
+
+  SetEvent(release);
+  low.join();
+  high.join();
+
+  tpool.Stop();
+
+  ASSERT_EQ(order.size(), 2u);
+  EXPECT_EQ(order[0], PRIORITY::HIGH);
+  EXPECT_EQ(order[1], PRIORITY::LOW);
+
+  auto stats = tpool.GetLaneStats(PRIORITY::LOW);
+  EXPECT_EQ(stats.Started, 1u);
+  EXPECT_GE(stats.MaxDelay, stats.TotalDelay / stats.Started);
+}
+
+TEST(Pool, priority_reserved)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(2);
+  tpool.SetReservedThreads(PRIORITY::HIGH, 1);
+  tpool.SetOverflowMode(OVERFLOW_MODE::FAIL);
+
+  HEvent release = CreateNotificationEvent();
+  auto block = [release]() { WaitForSingleObject(release); };
+
+  RunOptions low;
+  low.Priority = PRIORITY::LOW;
+
+  RunOptions high;
+  high.Priority = PRIORITY::HIGH;
+
+  EXPECT_NE(tpool.Run(block, low), nullptr);
+
+  // The second worker is reserved for HIGH lane
+  EXPECT_EQ(tpool.Run(block, low), nullptr);
+  EXPECT_NE(tpool.Run(block, high), nullptr);
+  EXPECT_EQ(tpool.Run(block, high), nullptr);
+
+  SetEvent(release);
+  tpool.Stop();
+}
+
+TEST(Pool, priority_deadline)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(1);
+
+  HEvent release = CreateNotificationEvent();
+  HEvent h = tpool.Run([release]() { WaitForSingleObject(release); });
+  ASSERT_NE(h, nullptr);
+
+  RunOptions drop;
+  drop.Priority = PRIORITY::NORMAL;
+  drop.Deadline = 50;
+  drop.Policy = DEADLINE_POLICY::DROP;
+
+  bool executed = false;
+  EXPECT_EQ(tpool.Run([&executed]() { executed = true; }, drop), nullptr);
+  EXPECT_EQ(tpool.GetLaneStats(PRIORITY::NORMAL).Expired, 1u);
+
+  RunOptions demote = drop;
+  demote.Policy = DEADLINE_POLICY::DEMOTE;
+
+  HEvent demoted;
+  std::thread producer(
+    [&]()
+    {
+      demoted = tpool.Run([&executed]() { executed = true; }, demote);
+    }
+  );
+
+  while (tpool.GetLaneStats(PRIORITY::NORMAL).Demoted == 0)
+    Sleep(1);
+
+  SetEvent(release);
+  producer.join();
+
+  ASSERT_NE(demoted, nullptr);
+  EXPECT_EQ(WaitForSingleObject(demoted, 5000), WAIT_RESULT::OBJECT_0);
+  EXPECT_TRUE(executed);
+
+  tpool.Stop();
+}
@@ -0,0 +1,121 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Pool.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+// Run() returns immediately while the only worker is busy. Queued tasks
+// are executed when it is free
+TEST(Pool, queue)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(1);
+  tpool.SetOverflowMode(OVERFLOW_MODE::QUEUE);
+
+  std::vector<std::pair<bool, size_t>> signals;
+  tpool.SetQueueLimits(
+    4
+    , 2
+    , [&signals](bool on, size_t n) { signals.push_back({on, n}); }
+  );
+
+  HEvent release = CreateNotificationEvent();
+  HEvent blocker = tpool.Run([release]() { WaitForSingleObject(release); });
+  ASSERT_NE(blocker, nullptr);
+
+  std::atomic<int> executed = 0;
+  std::vector<HEvent> handles;
+
+  for (int i = 0; i < 4; i++)
+  {
+    HEvent h = tpool.Run([&executed]() { executed++; });
+    ASSERT_NE(h, nullptr);
+    handles.push_back(h);
+  }
+
+  EXPECT_EQ(tpool.GetPendingTasks(), 4);
+  EXPECT_EQ(executed, 0);
+
+  // Capacity is exceeded
+  EXPECT_EQ(tpool.Run([&executed]() { executed++; }), nullptr);
+  EXPECT_EQ(tpool.GetPendingTasks(), 4);
+
+  ASSERT_FALSE(signals.empty());
+  EXPECT_TRUE(signals[0].first);
+
+  SetEvent(release);
+
+  for (auto& h : handles)
+    EXPECT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+
+  EXPECT_EQ(executed, 4);
+  EXPECT_EQ(tpool.GetPendingTasks(), 0);
+
+  ASSERT_EQ(signals.size(), 2);
+  EXPECT_FALSE(signals[1].first);
+
+  tpool.Stop();
+}
+
+// Stop() signals handles of tasks which are left in the queue
+TEST(Pool, queue_stop)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(1);
+  tpool.SetOverflowMode(OVERFLOW_MODE::QUEUE);
+
+  HEvent release = CreateNotificationEvent();
+  tpool.Run([release]() { WaitForSingleObject(release, 1000); });
+
+  bool executed = false;
+  HEvent h = tpool.Run([&executed]() { executed = true; });
+  ASSERT_NE(h, nullptr);
+
+  tpool.Stop();
+
+  EXPECT_EQ(WaitForSingleObject(h, 0), WAIT_RESULT::OBJECT_0);
+  EXPECT_FALSE(executed);
+}
+
+// Futures of queued tasks fail if the tasks are dropped
+TEST(Pool, queue_submit_dropped)
+{
+  Pool tpool;
+  tpool.SetMaxThreads(1);
+  tpool.SetOverflowMode(OVERFLOW_MODE::QUEUE);
+
+  HEvent release = CreateNotificationEvent();
+  tpool.Run([release]() { WaitForSingleObject(release, 5000); });
+
+  // Deadline is reached while the only worker is busy
+  RunOptions options;
+  options.Deadline = 10;
+  auto expired = tpool.Submit([]() { return 1; }, options);
+
+  Sleep(50);
+  SetEvent(release);
+
+  EXPECT_EQ(expired.Wait(5000), WAIT_RESULT::OBJECT_0);
+  EXPECT_THROW(expired.Get(), std::runtime_error);
+
+  // Task is left in the queue by Stop(). OnDrop of the caller is called
+  ResetEvent(release);
+  tpool.Run([release]() { WaitForSingleObject(release, 1000); });
+
+  std::atomic<int> dropped = 0;
+  RunOptions notify;
+  notify.OnDrop = [&dropped]() { dropped++; };
+  auto stopped = tpool.Submit([]() { return 2; }, notify);
+
+  tpool.Stop();
+
+  EXPECT_EQ(stopped.Wait(5000), WAIT_RESULT::OBJECT_0);
+  EXPECT_THROW(stopped.Get(), std::runtime_error);
+  EXPECT_EQ(dropped, 1);
+}
@@ -0,0 +1,57 @@
+#include <atomic>
+
+#include <gtest/gtest.h>
+#include <Syncme/Sleep.h>
+#include <Syncme/Sync.h>
+#include <Syncme/ThreadPool/Counter.h>
+#include <Syncme/ThreadPool/Pool.h>
+#include <Syncme/TickCount.h>
+
+using namespace Syncme;
+using namespace Syncme::ThreadPool;
+
+static bool WaitForThreadsUnused(uint64_t n, size_t timeout)
+{
+  uint64_t t0 = GetTimeInMillisec();
+  while (GetThreadsUnused() != n)
+  {
+    if (GetTimeInMillisec() - t0 >= timeout)
+      return false;
+
+    Sleep(1);
+  }
+
+  return true;
+}
+
+// MinThreads workers are started at once and are not stopped when
+// they expire
+TEST(Pool, min_threads)
+{
+  Pool tpool;
+  tpool.SetMaxUnusedThreads(0);
+  tpool.SetMaxIdleTime(1);
+  tpool.SetStackSize(256 * 1024);
+  tpool.SetMinThreads(4);
+
+  ASSERT_TRUE(WaitForThreadsUnused(4, 5000));
+  EXPECT_EQ(GetThreadsTotal(), 4);
+
+  uint64_t created = GetCreateInvoke();
+
+  std::atomic<int> executed = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    HEvent h = tpool.Run([&executed]() { executed++; });
+    ASSERT_NE(h, nullptr);
+    EXPECT_EQ(WaitForSingleObject(h, 5000), WAIT_RESULT::OBJECT_0);
+  }
+
+  EXPECT_EQ(executed, 4);
+  EXPECT_EQ(GetCreateInvoke(), created);
+
+  Sleep(50);
+  EXPECT_EQ(GetThreadsTotal(), 4);
+
+  tpool.Stop();
+}